@@ -0,0 +1,1871 @@
+#define DMOD_ENABLE_REGISTRATION    ON
+#ifndef DMOD_flashfs
+#   define DMOD_flashfs
+#endif
+
+#include "dmod.h"
+#include "dmfsi.h"
+#include "flashfs.h"
+#include "flashfs_sim.h"
+
+/**
+ * @brief FlashFS - Log-structured flash file system
+ *
+ * Example implementation of the DMFSI interface for flash memory. Nothing
+ * is ever overwritten in place: every change is appended as a record to the
+ * currently open segment (one erase sector). When a segment is full, a
+ * summary of its records is written at its end, so that at mount time the
+ * in-RAM index is rebuilt from the summaries and only the last segment has
+ * to be scanned record by record.
+ *
+ * Records:
+ *  - INODE  - creates or renames a file (the data is the name)
+ *  - DATA   - data written at an offset of a file
+ *  - DELETE - removes a file (offset holds the first segment of the file)
+ *
+ * Truncating a file deletes its inode and continues with a new one, so
+ * the records of the old contents are dead at once.
+ *
+ * Garbage collection reclaims the segment with the least live data, and
+ * when the erase counts drift apart, the least worn segment, to move its
+ * static data away (wear leveling). Free segments are taken in the order of
+ * their erase counts. It runs when the number of free segments gets low,
+ * and one step per _sync or FLASHFS_IOCTL_GC_STEP in the background.
+ *
+ * The flash device is simulated on top of a host file, see flashfs_sim.h.
+ * Example config string:
+ *
+ *      file=/tmp/flash.bin;type=nor;size=1m;sector=4k;page=256;erase_us=45000
+ */
+
+#define FLASHFS_CONTEXT_MAGIC   0x464C5346  // "FLSF" in hex
+#define FLASHFS_SEGMENT_MAGIC   0x464C5347  // "FLSG" in hex
+#define FLASHFS_SUMMARY_MAGIC   0x464C534D  // "FLSM" in hex
+#define FLASHFS_RECORD_MAGIC    0x5A46
+#define FLASHFS_ERASED_MAGIC    0xFFFF
+
+#define FLASHFS_REC_INODE       1
+#define FLASHFS_REC_DATA        2
+#define FLASHFS_REC_DELETE      3
+
+#define FLASHFS_NO_SEGMENT      0xFFFFFFFFu
+#define FLASHFS_NO_ADDR         0xFFFFFFFFu
+
+#define FLASHFS_GC_RESERVE      2       // Free segments kept for garbage collection
+#define FLASHFS_GC_BACKGROUND   4       // Free segments below which _sync collects
+#define FLASHFS_WEAR_THRESHOLD  16      // Erase count spread that triggers static wear leveling
+#define FLASHFS_MIN_CHUNK       64      // Smallest data record worth starting in a nearly full segment
+#define FLASHFS_HANDLE_BUFFER   512     // Write coalescing buffer of a file handle
+#define FLASHFS_MAX_NAME        255
+
+// Context check of operations on an opened handle (see DMFSI_VALIDATE_HOT_PATH)
+#if DMFSI_VALIDATE_HOT_PATH
+#   define FLASHFS_HOT_PATH_CTX_IS_VALID(ctx)  ((ctx) != NULL && (ctx)->magic == FLASHFS_CONTEXT_MAGIC)
+#else
+#   define FLASHFS_HOT_PATH_CTX_IS_VALID(ctx)  1
+#endif
+
+// On-flash structures
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               // Order of the segment in the log
+    uint32_t erase_count;       // Number of erases of the sector
+    uint32_t reserved;
+} flashfs_segment_header_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t type;               // FLASHFS_REC_*
+    uint8_t reserved;
+    uint32_t ino;
+    uint32_t offset;            // File offset of DATA records
+    uint32_t length;            // Number of bytes following the header
+    uint32_t check;             // Hash of the header fields and the data
+} flashfs_record_header_t;
+
+typedef struct {
+    uint32_t ino;
+    uint32_t offset;
+    uint32_t length_type;       // Length in the low 24 bits, type in the high 8 bits
+    uint32_t addr;              // Flash address of the record header
+} flashfs_summary_entry_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t magic;
+} flashfs_summary_footer_t;
+
+#define FLASHFS_HEADER_SIZE     ((uint32_t)sizeof(flashfs_record_header_t))
+#define FLASHFS_ENTRY_TYPE(e)   ((e)->length_type >> 24)
+#define FLASHFS_ENTRY_LENGTH(e) ((e)->length_type & 0x00FFFFFFu)
+
+// Segment states
+#define FLASHFS_SEG_FREE        0
+#define FLASHFS_SEG_OPEN        1
+#define FLASHFS_SEG_SEALED      2       // Has a summary
+#define FLASHFS_SEG_UNSEALED    3       // Closed without a summary (found at mount)
+
+typedef struct {
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t live;              // Bytes still referenced by the index
+    uint8_t state;
+    uint8_t erased;
+} flashfs_segment_t;
+
+// In-RAM index
+typedef struct {
+    uint32_t offset;            // File offset
+    uint32_t length;
+    uint32_t addr;              // Flash address of the data
+} flashfs_extent_t;
+
+typedef struct flashfs_inode_s {
+    uint32_t ino;
+    uint32_t size;
+    uint32_t rec_addr;          // INODE record, FLASHFS_NO_ADDR if not known yet
+    uint32_t rec_size;
+    uint32_t first_seq;         // Oldest segment that may hold records of the inode
+    char* name;
+    flashfs_extent_t* extents;  // Sorted by file offset, not overlapping
+    uint32_t extent_count;
+    uint32_t extent_capacity;
+    struct flashfs_inode_s* next;
+} flashfs_inode_t;
+
+typedef struct {
+    flashfs_inode_t* inode;
+    uint32_t position;
+    int mode;
+    uint32_t buffer_offset;     // File offset of the buffered data
+    uint32_t buffer_length;
+    uint8_t buffer[FLASHFS_HANDLE_BUFFER];
+} flashfs_handle_t;
+
+typedef struct {
+    flashfs_inode_t* next;
+    char path[FLASHFS_MAX_NAME + 1];
+} flashfs_dir_t;
+
+// Context structure definition
+struct dmfsi_context {
+    uint32_t magic;
+    flashfs_sim_t sim;
+    flashfs_segment_t* segments;
+    uint32_t segment_count;
+    uint32_t next_seq;
+    uint32_t next_ino;
+    flashfs_inode_t* inodes;
+    uint32_t open_segment;              // FLASHFS_NO_SEGMENT if none
+    uint32_t write_offset;              // Next free byte of the open segment
+    uint32_t programmed;                // Bytes of the open segment already on flash
+    uint32_t wbuf_offset;               // Segment offset of the page in wbuf
+    uint8_t* wbuf;                      // Page being filled
+    flashfs_summary_entry_t* summary;   // Records of the open segment
+    uint32_t summary_count;
+    uint32_t summary_capacity;
+    int in_gc;
+    flashfs_stats_t stats;
+};
+
+// Helper functions to replace stdlib functions
+static int flashfs_strcmp(const char* s1, const char* s2)
+{
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+static size_t flashfs_strlen(const char* s)
+{
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+static void* flashfs_memcpy(void* dest, const void* src, size_t n)
+{
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+    return dest;
+}
+
+static void flashfs_memset(void* dest, int value, size_t n)
+{
+    unsigned char* d = (unsigned char*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (unsigned char)value;
+    }
+}
+
+static uint32_t flashfs_hash(uint32_t hash, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t flashfs_align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+static uint32_t flashfs_record_check(const flashfs_record_header_t* header, const void* data)
+{
+    uint32_t hash = 2166136261u;
+    hash = flashfs_hash(hash, &header->type, sizeof(header->type));
+    hash = flashfs_hash(hash, &header->ino, sizeof(header->ino));
+    hash = flashfs_hash(hash, &header->offset, sizeof(header->offset));
+    hash = flashfs_hash(hash, &header->length, sizeof(header->length));
+    return flashfs_hash(hash, data, header->length);
+}
+
+// ----------------------------------------------------------------------------
+//  Flash access
+// ----------------------------------------------------------------------------
+
+// End of the area available for records when the summary has `entries` entries
+static uint32_t flashfs_record_limit(dmfsi_context_t ctx, uint32_t entries)
+{
+    uint32_t summary = entries * (uint32_t)sizeof(flashfs_summary_entry_t)
+                     + (uint32_t)sizeof(flashfs_summary_footer_t);
+    if (summary >= ctx->sim.sector_size) {
+        return 0;
+    }
+    uint32_t limit = ctx->sim.sector_size - summary;
+    return limit - (limit % ctx->sim.page_size);
+}
+
+// Read from flash, including the data still waiting in the write buffer
+static int flashfs_read_flash(dmfsi_context_t ctx, uint32_t addr, void* buffer, uint32_t size)
+{
+    uint8_t* out = (uint8_t*)buffer;
+    if (ctx->open_segment != FLASHFS_NO_SEGMENT) {
+        uint32_t base = ctx->open_segment * ctx->sim.sector_size;
+        uint32_t buffered_start = base + ctx->wbuf_offset;
+        uint32_t buffered_end = base + ctx->write_offset;
+        if (addr + size > buffered_start && addr < buffered_end) {
+            // Part before the buffered page comes from the flash
+            if (addr < buffered_start) {
+                uint32_t head = buffered_start - addr;
+                if (flashfs_sim_read(&ctx->sim, addr, out, head) != 0) {
+                    return DMFSI_ERR_GENERAL;
+                }
+                out += head;
+                addr += head;
+                size -= head;
+            }
+            uint32_t chunk = buffered_end - addr;
+            if (chunk > size) {
+                chunk = size;
+            }
+            flashfs_memcpy(out, ctx->wbuf + (addr - buffered_start), chunk);
+            out += chunk;
+            addr += chunk;
+            size -= chunk;
+        }
+    }
+    if (size > 0 && flashfs_sim_read(&ctx->sim, addr, out, size) != 0) {
+        return DMFSI_ERR_GENERAL;
+    }
+    return DMFSI_OK;
+}
+
+// Program the buffered page up to the write offset
+static int flashfs_flush_page(dmfsi_context_t ctx, int pad)
+{
+    uint32_t base = ctx->open_segment * ctx->sim.sector_size;
+    uint32_t page = ctx->sim.page_size;
+    int result = 0;
+
+    if (ctx->sim.type == FLASHFS_SIM_NAND) {
+        // A NAND page is programmed once, as a whole
+        if (ctx->write_offset - ctx->wbuf_offset < page && !pad) {
+            return DMFSI_OK;
+        }
+        if (ctx->write_offset > ctx->wbuf_offset) {
+            result = flashfs_sim_program(&ctx->sim, base + ctx->wbuf_offset, ctx->wbuf, page);
+            ctx->write_offset = ctx->wbuf_offset + page;
+            ctx->programmed = ctx->write_offset;
+        }
+    } else {
+        uint32_t start = (ctx->programmed > ctx->wbuf_offset) ? ctx->programmed : ctx->wbuf_offset;
+        if (ctx->write_offset > start) {
+            result = flashfs_sim_program(&ctx->sim, base + start,
+                                         ctx->wbuf + (start - ctx->wbuf_offset),
+                                         ctx->write_offset - start);
+            ctx->programmed = ctx->write_offset;
+        }
+    }
+    if (result != 0) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    if (ctx->write_offset - ctx->wbuf_offset >= page) {
+        ctx->wbuf_offset += page;
+        flashfs_memset(ctx->wbuf, 0xFF, page);
+    }
+    return DMFSI_OK;
+}
+
+// Append bytes to the open segment through the page buffer
+static int flashfs_buffer_write(dmfsi_context_t ctx, const void* data, uint32_t size)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    while (size > 0) {
+        uint32_t in_page = ctx->write_offset - ctx->wbuf_offset;
+        uint32_t chunk = ctx->sim.page_size - in_page;
+        if (chunk > size) {
+            chunk = size;
+        }
+        flashfs_memcpy(ctx->wbuf + in_page, in, chunk);
+        ctx->write_offset += chunk;
+        in += chunk;
+        size -= chunk;
+        if (ctx->write_offset - ctx->wbuf_offset == ctx->sim.page_size) {
+            int result = flashfs_flush_page(ctx, 0);
+            if (result != DMFSI_OK) {
+                return result;
+            }
+        }
+    }
+    return DMFSI_OK;
+}
+
+// Erase a segment and mark it free
+static int flashfs_erase_segment(dmfsi_context_t ctx, uint32_t index)
+{
+    if (flashfs_sim_erase(&ctx->sim, index) != 0) {
+        return DMFSI_ERR_GENERAL;
+    }
+    flashfs_segment_t* seg = &ctx->segments[index];
+    seg->erase_count++;
+    seg->state = FLASHFS_SEG_FREE;
+    seg->erased = 1;
+    seg->live = 0;
+    ctx->stats.erases++;
+    return DMFSI_OK;
+}
+
+// ----------------------------------------------------------------------------
+//  In-RAM index
+// ----------------------------------------------------------------------------
+
+static void flashfs_live_sub(dmfsi_context_t ctx, uint32_t addr, uint32_t size)
+{
+    flashfs_segment_t* seg = &ctx->segments[addr / ctx->sim.sector_size];
+    seg->live = (seg->live > size) ? seg->live - size : 0;
+}
+
+static void flashfs_live_add(dmfsi_context_t ctx, uint32_t addr, uint32_t size)
+{
+    ctx->segments[addr / ctx->sim.sector_size].live += size;
+}
+
+static flashfs_inode_t* flashfs_find_ino(dmfsi_context_t ctx, uint32_t ino)
+{
+    for (flashfs_inode_t* inode = ctx->inodes; inode != NULL; inode = inode->next) {
+        if (inode->ino == ino) {
+            return inode;
+        }
+    }
+    return NULL;
+}
+
+static flashfs_inode_t* flashfs_find_name(dmfsi_context_t ctx, const char* name)
+{
+    for (flashfs_inode_t* inode = ctx->inodes; inode != NULL; inode = inode->next) {
+        if (inode->name != NULL && flashfs_strcmp(inode->name, name) == 0) {
+            return inode;
+        }
+    }
+    return NULL;
+}
+
+static flashfs_inode_t* flashfs_new_inode(dmfsi_context_t ctx, uint32_t ino, uint32_t first_seq)
+{
+    flashfs_inode_t* inode = (flashfs_inode_t*)Dmod_Malloc(sizeof(flashfs_inode_t));
+    if (inode == NULL) {
+        return NULL;
+    }
+    inode->ino = ino;
+    inode->size = 0;
+    inode->rec_addr = FLASHFS_NO_ADDR;
+    inode->rec_size = 0;
+    inode->first_seq = first_seq;
+    inode->name = NULL;
+    inode->extents = NULL;
+    inode->extent_count = 0;
+    inode->extent_capacity = 0;
+    inode->next = ctx->inodes;
+    ctx->inodes = inode;
+    if (ino >= ctx->next_ino) {
+        ctx->next_ino = ino + 1;
+    }
+    return inode;
+}
+
+// Drop all data of an inode from the index
+static void flashfs_clear_extents(dmfsi_context_t ctx, flashfs_inode_t* inode)
+{
+    for (uint32_t i = 0; i < inode->extent_count; i++) {
+        flashfs_live_sub(ctx, inode->extents[i].addr, inode->extents[i].length);
+    }
+    if (inode->extents != NULL) {
+        Dmod_Free(inode->extents);
+    }
+    inode->extents = NULL;
+    inode->extent_count = 0;
+    inode->extent_capacity = 0;
+    inode->size = 0;
+}
+
+static void flashfs_remove_inode(dmfsi_context_t ctx, flashfs_inode_t* inode)
+{
+    flashfs_inode_t** link = &ctx->inodes;
+    while (*link != NULL && *link != inode) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return;
+    }
+    *link = inode->next;
+
+    flashfs_clear_extents(ctx, inode);
+    if (inode->rec_addr != FLASHFS_NO_ADDR) {
+        flashfs_live_sub(ctx, inode->rec_addr, inode->rec_size);
+    }
+    if (inode->name != NULL) {
+        Dmod_Free(inode->name);
+    }
+    Dmod_Free(inode);
+}
+
+// Map [offset, offset + length) of the file to `addr`, replacing older data
+static int flashfs_map_extent(dmfsi_context_t ctx, flashfs_inode_t* inode,
+                              uint32_t offset, uint32_t length, uint32_t addr)
+{
+    uint32_t end = offset + length;
+    flashfs_extent_t* last = (inode->extent_count > 0) ? &inode->extents[inode->extent_count - 1] : NULL;
+
+    if (last == NULL || last->offset + last->length <= offset) {
+        // Appending to the file - the common case, no overlap possible
+        if (inode->extent_count == inode->extent_capacity) {
+            uint32_t capacity = inode->extent_capacity ? inode->extent_capacity * 2 : 4;
+            flashfs_extent_t* extents = (flashfs_extent_t*)Dmod_Malloc(capacity * sizeof(flashfs_extent_t));
+            if (extents == NULL) {
+                return DMFSI_ERR_NO_SPACE;
+            }
+            if (inode->extents != NULL) {
+                flashfs_memcpy(extents, inode->extents, inode->extent_count * sizeof(flashfs_extent_t));
+                Dmod_Free(inode->extents);
+            }
+            inode->extents = extents;
+            inode->extent_capacity = capacity;
+        }
+        flashfs_extent_t* e = &inode->extents[inode->extent_count++];
+        e->offset = offset;
+        e->length = length;
+        e->addr = addr;
+    } else {
+        // Overwrite - rebuild the list, trimming the overlapped extents
+        uint32_t capacity = inode->extent_count + 2;
+        flashfs_extent_t* extents = (flashfs_extent_t*)Dmod_Malloc(capacity * sizeof(flashfs_extent_t));
+        if (extents == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+        uint32_t count = 0;
+        int inserted = 0;
+        for (uint32_t i = 0; i < inode->extent_count; i++) {
+            flashfs_extent_t e = inode->extents[i];
+            uint32_t e_end = e.offset + e.length;
+            if (!inserted && e.offset >= offset) {
+                extents[count++] = (flashfs_extent_t){ offset, length, addr };
+                inserted = 1;
+            }
+            if (e_end <= offset || e.offset >= end) {
+                extents[count++] = e;
+                continue;
+            }
+            uint32_t cut_start = (e.offset > offset) ? e.offset : offset;
+            uint32_t cut_end = (e_end < end) ? e_end : end;
+            flashfs_live_sub(ctx, e.addr, cut_end - cut_start);
+            if (e.offset < offset) {
+                extents[count++] = (flashfs_extent_t){ e.offset, offset - e.offset, e.addr };
+            }
+            if (e_end > end) {
+                if (!inserted) {
+                    extents[count++] = (flashfs_extent_t){ offset, length, addr };
+                    inserted = 1;
+                }
+                extents[count++] = (flashfs_extent_t){ end, e_end - end, e.addr + (end - e.offset) };
+            }
+        }
+        if (!inserted) {
+            extents[count++] = (flashfs_extent_t){ offset, length, addr };
+        }
+        Dmod_Free(inode->extents);
+        inode->extents = extents;
+        inode->extent_count = count;
+        inode->extent_capacity = capacity;
+    }
+
+    flashfs_live_add(ctx, addr, length);
+    if (end > inode->size) {
+        inode->size = end;
+    }
+    return DMFSI_OK;
+}
+
+// Set the name of an inode from its INODE record
+static int flashfs_set_name(dmfsi_context_t ctx, flashfs_inode_t* inode, const char* name,
+                            uint32_t length, uint32_t rec_addr, uint32_t rec_size)
+{
+    char* copy = (char*)Dmod_Malloc(length + 1);
+    if (copy == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    flashfs_memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    if (inode->name != NULL) {
+        Dmod_Free(inode->name);
+    }
+    if (inode->rec_addr != FLASHFS_NO_ADDR) {
+        flashfs_live_sub(ctx, inode->rec_addr, inode->rec_size);
+    }
+    inode->name = copy;
+    inode->rec_addr = rec_addr;
+    inode->rec_size = rec_size;
+    flashfs_live_add(ctx, rec_addr, rec_size);
+    return DMFSI_OK;
+}
+
+// ----------------------------------------------------------------------------
+//  Log
+// ----------------------------------------------------------------------------
+
+static int flashfs_gc_step(dmfsi_context_t ctx);
+
+// Sequence number of the segment the next record goes to (or earlier)
+static uint32_t flashfs_current_seq(dmfsi_context_t ctx)
+{
+    return (ctx->open_segment != FLASHFS_NO_SEGMENT) ? ctx->segments[ctx->open_segment].seq : ctx->next_seq;
+}
+
+static uint32_t flashfs_free_segments(dmfsi_context_t ctx)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        if (ctx->segments[i].state == FLASHFS_SEG_FREE) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Write the summary of the open segment and close it
+static int flashfs_seal_segment(dmfsi_context_t ctx)
+{
+    if (ctx->open_segment == FLASHFS_NO_SEGMENT) {
+        return DMFSI_OK;
+    }
+    int result = flashfs_flush_page(ctx, 1);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    uint32_t start = flashfs_record_limit(ctx, ctx->summary_count);
+    uint32_t size = ctx->sim.sector_size - start;
+    uint8_t* region = (uint8_t*)Dmod_Malloc(size);
+    if (region == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    flashfs_memset(region, 0xFF, size);
+
+    uint32_t entries_size = ctx->summary_count * (uint32_t)sizeof(flashfs_summary_entry_t);
+    flashfs_summary_footer_t footer = { ctx->summary_count, FLASHFS_SUMMARY_MAGIC };
+    flashfs_memcpy(region + size - sizeof(footer) - entries_size, ctx->summary, entries_size);
+    flashfs_memcpy(region + size - sizeof(footer), &footer, sizeof(footer));
+
+    uint32_t base = ctx->open_segment * ctx->sim.sector_size;
+    result = flashfs_sim_program(&ctx->sim, base + start, region, size);
+    Dmod_Free(region);
+    if (result != 0) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    ctx->segments[ctx->open_segment].state = FLASHFS_SEG_SEALED;
+    ctx->open_segment = FLASHFS_NO_SEGMENT;
+    ctx->summary_count = 0;
+    return DMFSI_OK;
+}
+
+// Start a new segment on the least worn free sector
+static int flashfs_open_segment(dmfsi_context_t ctx)
+{
+    // Keep enough free segments for the garbage collection to make progress
+    for (uint32_t i = 0; !ctx->in_gc && i < ctx->segment_count
+                         && flashfs_free_segments(ctx) <= FLASHFS_GC_RESERVE; i++) {
+        if (flashfs_gc_step(ctx) != DMFSI_OK) {
+            break;
+        }
+    }
+    if (ctx->open_segment != FLASHFS_NO_SEGMENT) {
+        // The garbage collection has already started a new segment
+        return DMFSI_OK;
+    }
+    uint32_t free_count = flashfs_free_segments(ctx);
+    if (free_count == 0 || (!ctx->in_gc && free_count < FLASHFS_GC_RESERVE)) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    uint32_t index = FLASHFS_NO_SEGMENT;
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        if (ctx->segments[i].state == FLASHFS_SEG_FREE
+            && (index == FLASHFS_NO_SEGMENT || ctx->segments[i].erase_count < ctx->segments[index].erase_count)) {
+            index = i;
+        }
+    }
+    if (!ctx->segments[index].erased) {
+        int result = flashfs_erase_segment(ctx, index);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    }
+
+    flashfs_segment_t* seg = &ctx->segments[index];
+    seg->state = FLASHFS_SEG_OPEN;
+    seg->erased = 0;
+    seg->seq = ctx->next_seq++;
+    seg->live = 0;
+
+    ctx->open_segment = index;
+    ctx->write_offset = 0;
+    ctx->programmed = 0;
+    ctx->wbuf_offset = 0;
+    ctx->summary_count = 0;
+    flashfs_memset(ctx->wbuf, 0xFF, ctx->sim.page_size);
+
+    flashfs_segment_header_t header = { FLASHFS_SEGMENT_MAGIC, seg->seq, seg->erase_count, 0xFFFFFFFFu };
+    return flashfs_buffer_write(ctx, &header, sizeof(header));
+}
+
+// Payload bytes that still fit in the open segment
+static uint32_t flashfs_room(dmfsi_context_t ctx)
+{
+    if (ctx->open_segment == FLASHFS_NO_SEGMENT || ctx->summary_count >= ctx->summary_capacity) {
+        return 0;
+    }
+    uint32_t limit = flashfs_record_limit(ctx, ctx->summary_count + 1);
+    uint32_t used = flashfs_align_up(ctx->write_offset, 4) + FLASHFS_HEADER_SIZE;
+    return (limit > used) ? ((limit - used) & ~3u) : 0;
+}
+
+// Check if a record with `length` bytes of payload fits in the open segment
+static int flashfs_fits(dmfsi_context_t ctx, uint32_t length)
+{
+    if (ctx->open_segment == FLASHFS_NO_SEGMENT || ctx->summary_count >= ctx->summary_capacity) {
+        return 0;
+    }
+    uint32_t limit = flashfs_record_limit(ctx, ctx->summary_count + 1);
+    uint32_t used = flashfs_align_up(ctx->write_offset, 4) + FLASHFS_HEADER_SIZE;
+    return limit >= used && limit - used >= length;
+}
+
+// Append a record and return the flash address of its header
+static int flashfs_append(dmfsi_context_t ctx, uint8_t type, uint32_t ino, uint32_t offset,
+                          const void* data, uint32_t length, uint32_t* addr)
+{
+    // Two attempts - the segment started by the garbage collection may be already full
+    for (int attempt = 0; attempt < 2 && !flashfs_fits(ctx, length); attempt++) {
+        int result = flashfs_seal_segment(ctx);
+        if (result == DMFSI_OK) {
+            result = flashfs_open_segment(ctx);
+        }
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    }
+    if (!flashfs_fits(ctx, length)) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    static const uint8_t padding[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    uint32_t pad = flashfs_align_up(ctx->write_offset, 4) - ctx->write_offset;
+    int result = flashfs_buffer_write(ctx, padding, pad);
+
+    flashfs_record_header_t header;
+    header.magic = FLASHFS_RECORD_MAGIC;
+    header.type = type;
+    header.reserved = 0xFF;
+    header.ino = ino;
+    header.offset = offset;
+    header.length = length;
+    header.check = flashfs_record_check(&header, data);
+
+    *addr = ctx->open_segment * ctx->sim.sector_size + ctx->write_offset;
+    if (result == DMFSI_OK) {
+        result = flashfs_buffer_write(ctx, &header, sizeof(header));
+    }
+    if (result == DMFSI_OK) {
+        result = flashfs_buffer_write(ctx, data, length);
+    }
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    flashfs_summary_entry_t* entry = &ctx->summary[ctx->summary_count++];
+    entry->ino = ino;
+    entry->offset = offset;
+    entry->length_type = length | ((uint32_t)type << 24);
+    entry->addr = *addr;
+    return DMFSI_OK;
+}
+
+// Largest payload of a data record, so that it fits a fresh segment
+static uint32_t flashfs_max_payload(dmfsi_context_t ctx)
+{
+    return (flashfs_record_limit(ctx, 1) - sizeof(flashfs_segment_header_t) - FLASHFS_HEADER_SIZE) & ~3u;
+}
+
+// Append data of a file, splitting it between segments if needed
+static int flashfs_write_data(dmfsi_context_t ctx, flashfs_inode_t* inode, uint32_t offset,
+                              const uint8_t* data, uint32_t length)
+{
+    while (length > 0) {
+        uint32_t chunk = flashfs_room(ctx);
+        if (chunk < length && chunk < FLASHFS_MIN_CHUNK) {
+            // Not worth starting the record here - take a full fresh segment
+            chunk = flashfs_max_payload(ctx);
+        }
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        uint32_t addr;
+        int result = flashfs_append(ctx, FLASHFS_REC_DATA, inode->ino, offset, data, chunk, &addr);
+        if (result == DMFSI_OK) {
+            result = flashfs_map_extent(ctx, inode, offset, chunk, addr + FLASHFS_HEADER_SIZE);
+        }
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        offset += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return DMFSI_OK;
+}
+
+// The tombstone keeps the first segment of the inode, so that the garbage
+// collection knows when no cancelled records are left and it can be dropped
+static int flashfs_write_delete(dmfsi_context_t ctx, uint32_t ino, uint32_t first_seq)
+{
+    uint32_t addr;
+    return flashfs_append(ctx, FLASHFS_REC_DELETE, ino, first_seq, NULL, 0, &addr);
+}
+
+static int flashfs_write_inode(dmfsi_context_t ctx, flashfs_inode_t* inode, const char* name)
+{
+    uint32_t length = (uint32_t)flashfs_strlen(name);
+    uint32_t addr;
+    int result = flashfs_append(ctx, FLASHFS_REC_INODE, inode->ino, 0, name, length, &addr);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    return flashfs_set_name(ctx, inode, name, length, addr, FLASHFS_HEADER_SIZE + length);
+}
+
+// Read a range of a file - ranges not covered by any record read as zeros
+static int flashfs_read_file(dmfsi_context_t ctx, flashfs_inode_t* inode, uint32_t offset,
+                             uint8_t* buffer, uint32_t length)
+{
+    // Binary search of the first extent ending after the offset
+    uint32_t lo = 0;
+    uint32_t hi = inode->extent_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (inode->extents[mid].offset + inode->extents[mid].length <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    uint32_t end = offset + length;
+    uint32_t pos = offset;
+    for (uint32_t i = lo; i < inode->extent_count && pos < end; i++) {
+        flashfs_extent_t* e = &inode->extents[i];
+        if (e->offset >= end) {
+            break;
+        }
+        if (e->offset > pos) {
+            flashfs_memset(buffer + (pos - offset), 0, e->offset - pos);
+            pos = e->offset;
+        }
+        uint32_t e_end = e->offset + e->length;
+        uint32_t chunk = ((e_end < end) ? e_end : end) - pos;
+        int result = flashfs_read_flash(ctx, e->addr + (pos - e->offset), buffer + (pos - offset), chunk);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        pos += chunk;
+    }
+    if (pos < end) {
+        flashfs_memset(buffer + (pos - offset), 0, end - pos);
+    }
+    return DMFSI_OK;
+}
+
+// ----------------------------------------------------------------------------
+//  Mount and garbage collection
+// ----------------------------------------------------------------------------
+
+// Get the records of a closed segment, from the summary or by scanning it
+static int flashfs_load_entries(dmfsi_context_t ctx, uint32_t index,
+                                flashfs_summary_entry_t** entries, uint32_t* count, uint32_t* end)
+{
+    uint32_t base = index * ctx->sim.sector_size;
+    *entries = NULL;
+    *count = 0;
+    *end = sizeof(flashfs_segment_header_t);
+
+    if (ctx->segments[index].state == FLASHFS_SEG_SEALED) {
+        flashfs_summary_footer_t footer;
+        int result = flashfs_read_flash(ctx, base + ctx->sim.sector_size - sizeof(footer), &footer, sizeof(footer));
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        if (footer.count > 0) {
+            uint32_t size = footer.count * (uint32_t)sizeof(flashfs_summary_entry_t);
+            *entries = (flashfs_summary_entry_t*)Dmod_Malloc(size);
+            if (*entries == NULL) {
+                return DMFSI_ERR_NO_SPACE;
+            }
+            result = flashfs_read_flash(ctx, base + ctx->sim.sector_size - sizeof(footer) - size, *entries, size);
+            if (result != DMFSI_OK) {
+                Dmod_Free(*entries);
+                *entries = NULL;
+                return result;
+            }
+        }
+        *count = footer.count;
+        *end = flashfs_record_limit(ctx, footer.count);
+        ctx->stats.mount_summaries++;
+        return DMFSI_OK;
+    }
+
+    // No summary - walk the records and verify them, the last one may be torn
+    uint32_t capacity = ctx->summary_capacity;
+    uint8_t* data = (uint8_t*)Dmod_Malloc(ctx->sim.sector_size);
+    *entries = (flashfs_summary_entry_t*)Dmod_Malloc(capacity * sizeof(flashfs_summary_entry_t));
+    if (data == NULL || *entries == NULL) {
+        if (data != NULL) {
+            Dmod_Free(data);
+        }
+        if (*entries != NULL) {
+            Dmod_Free(*entries);
+            *entries = NULL;
+        }
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    uint32_t offset = sizeof(flashfs_segment_header_t);
+    uint32_t page = ctx->sim.page_size;
+    int torn = 0;
+    while (*count < capacity && offset + FLASHFS_HEADER_SIZE <= ctx->sim.sector_size) {
+        flashfs_record_header_t header;
+        if (flashfs_read_flash(ctx, base + offset, &header, sizeof(header)) != DMFSI_OK) {
+            break;
+        }
+        if (header.magic == FLASHFS_ERASED_MAGIC) {
+            // Either the end of the log, or padding up to the next page after a sync
+            if (offset % page == 0) {
+                break;
+            }
+            offset = flashfs_align_up(offset, page);
+            continue;
+        }
+        if (header.magic != FLASHFS_RECORD_MAGIC
+            || header.length > ctx->sim.sector_size - offset - FLASHFS_HEADER_SIZE
+            || flashfs_read_flash(ctx, base + offset + FLASHFS_HEADER_SIZE, data, header.length) != DMFSI_OK
+            || flashfs_record_check(&header, data) != header.check) {
+            torn = 1;
+            break;
+        }
+        flashfs_summary_entry_t* entry = &(*entries)[(*count)++];
+        entry->ino = header.ino;
+        entry->offset = header.offset;
+        entry->length_type = header.length | ((uint32_t)header.type << 24);
+        entry->addr = base + offset;
+        offset = flashfs_align_up(offset + FLASHFS_HEADER_SIZE + header.length, 4);
+    }
+    Dmod_Free(data);
+    // The log must not continue over a partially written record
+    *end = torn ? ctx->sim.sector_size : flashfs_align_up(offset, page);
+    ctx->stats.mount_scans++;
+    return DMFSI_OK;
+}
+
+// Apply a record to the in-RAM index
+static int flashfs_replay(dmfsi_context_t ctx, const flashfs_summary_entry_t* entry)
+{
+    uint32_t type = FLASHFS_ENTRY_TYPE(entry);
+    uint32_t length = FLASHFS_ENTRY_LENGTH(entry);
+    flashfs_inode_t* inode = flashfs_find_ino(ctx, entry->ino);
+
+    ctx->stats.mount_records++;
+    if (entry->ino >= ctx->next_ino) {
+        ctx->next_ino = entry->ino + 1;
+    }
+    if (type == FLASHFS_REC_DELETE) {
+        if (inode != NULL) {
+            flashfs_remove_inode(ctx, inode);
+        }
+        return DMFSI_OK;
+    }
+
+    // Data copied by the garbage collection may come before the INODE record
+    if (inode == NULL) {
+        inode = flashfs_new_inode(ctx, entry->ino, ctx->segments[entry->addr / ctx->sim.sector_size].seq);
+        if (inode == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+    }
+
+    if (type == FLASHFS_REC_INODE) {
+        char name[FLASHFS_MAX_NAME + 1];
+        if (length > FLASHFS_MAX_NAME) {
+            return DMFSI_ERR_INVALID;
+        }
+        int result = flashfs_read_flash(ctx, entry->addr + FLASHFS_HEADER_SIZE, name, length);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        return flashfs_set_name(ctx, inode, name, length, entry->addr, FLASHFS_HEADER_SIZE + length);
+    }
+    if (type == FLASHFS_REC_DATA) {
+        return flashfs_map_extent(ctx, inode, entry->offset, length, entry->addr + FLASHFS_HEADER_SIZE);
+    }
+    return DMFSI_OK;
+}
+
+// Rebuild the in-RAM index from the flash
+static int flashfs_mount(dmfsi_context_t ctx)
+{
+    uint64_t start_time = ctx->sim.time_us;
+    uint32_t* order = (uint32_t*)Dmod_Malloc(ctx->segment_count * sizeof(uint32_t));
+    if (order == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    // Read the headers and sort the used segments by their sequence number
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        flashfs_segment_t* seg = &ctx->segments[i];
+        flashfs_segment_header_t header;
+        uint32_t base = i * ctx->sim.sector_size;
+        seg->live = 0;
+        if (flashfs_sim_read(&ctx->sim, base, &header, sizeof(header)) != 0) {
+            Dmod_Free(order);
+            return DMFSI_ERR_GENERAL;
+        }
+        if (header.magic != FLASHFS_SEGMENT_MAGIC) {
+            seg->state = FLASHFS_SEG_FREE;
+            seg->erased = (header.magic == 0xFFFFFFFFu && header.seq == 0xFFFFFFFFu);
+            seg->erase_count = 0;
+            seg->seq = 0;
+            continue;
+        }
+        flashfs_summary_footer_t footer;
+        if (flashfs_sim_read(&ctx->sim, base + ctx->sim.sector_size - sizeof(footer), &footer, sizeof(footer)) != 0) {
+            Dmod_Free(order);
+            return DMFSI_ERR_GENERAL;
+        }
+        seg->state = (footer.magic == FLASHFS_SUMMARY_MAGIC) ? FLASHFS_SEG_SEALED : FLASHFS_SEG_UNSEALED;
+        seg->erased = 0;
+        seg->seq = header.seq;
+        seg->erase_count = header.erase_count;
+        if (header.seq >= ctx->next_seq) {
+            ctx->next_seq = header.seq + 1;
+        }
+
+        uint32_t j = used++;
+        while (j > 0 && ctx->segments[order[j - 1]].seq > header.seq) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    // Erased sectors carry no header - assume they are as worn as the least worn used one
+    uint32_t min_erase = (used > 0) ? 0xFFFFFFFFu : 0;
+    for (uint32_t n = 0; n < used; n++) {
+        uint32_t count = ctx->segments[order[n]].erase_count;
+        min_erase = (count < min_erase) ? count : min_erase;
+    }
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        if (ctx->segments[i].state == FLASHFS_SEG_FREE) {
+            ctx->segments[i].erase_count = min_erase;
+        }
+    }
+
+    int result = DMFSI_OK;
+    for (uint32_t n = 0; n < used && result == DMFSI_OK; n++) {
+        flashfs_summary_entry_t* entries;
+        uint32_t count;
+        uint32_t end;
+        result = flashfs_load_entries(ctx, order[n], &entries, &count, &end);
+        for (uint32_t i = 0; i < count && result == DMFSI_OK; i++) {
+            result = flashfs_replay(ctx, &entries[i]);
+        }
+
+        // The newest segment without summary is where the log continues
+        if (result == DMFSI_OK && n == used - 1
+            && ctx->segments[order[n]].state == FLASHFS_SEG_UNSEALED
+            && end < flashfs_record_limit(ctx, count + 1)) {
+            ctx->segments[order[n]].state = FLASHFS_SEG_OPEN;
+            ctx->open_segment = order[n];
+            ctx->write_offset = end;
+            ctx->programmed = end;
+            ctx->wbuf_offset = end;
+            ctx->summary_count = count;
+            flashfs_memcpy(ctx->summary, entries, count * sizeof(flashfs_summary_entry_t));
+            flashfs_memset(ctx->wbuf, 0xFF, ctx->sim.page_size);
+        }
+        if (entries != NULL) {
+            Dmod_Free(entries);
+        }
+    }
+    Dmod_Free(order);
+
+    // Data of files that were removed before their records were collected
+    flashfs_inode_t* inode = ctx->inodes;
+    while (inode != NULL) {
+        flashfs_inode_t* next = inode->next;
+        if (inode->name == NULL) {
+            flashfs_remove_inode(ctx, inode);
+        }
+        inode = next;
+    }
+
+    ctx->stats.mount_time_us = (uint32_t)(ctx->sim.time_us - start_time);
+    return result;
+}
+
+// Check if a tombstone in `victim` may still cancel records in older segments
+static int flashfs_tombstone_needed(dmfsi_context_t ctx, uint32_t victim, uint32_t first_seq)
+{
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        flashfs_segment_t* seg = &ctx->segments[i];
+        if (i != victim && seg->state != FLASHFS_SEG_FREE
+            && seg->seq >= first_seq && seg->seq < ctx->segments[victim].seq) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reclaim a single segment
+static int flashfs_gc_step(dmfsi_context_t ctx)
+{
+    // Wear of the segments holding data, compared to the most worn one
+    uint32_t min_erase = 0xFFFFFFFFu;
+    uint32_t max_erase = 0;
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        uint32_t count = ctx->segments[i].erase_count;
+        if (ctx->segments[i].state != FLASHFS_SEG_FREE) {
+            min_erase = (count < min_erase) ? count : min_erase;
+        }
+        max_erase = (count > max_erase) ? count : max_erase;
+    }
+
+    // Victim: the least worn segment when wear gets uneven and there is room
+    // to move a full segment, otherwise the one with the least live data
+    // (on a tie, the less worn one)
+    int wear_leveling = (min_erase != 0xFFFFFFFFu && max_erase - min_erase > FLASHFS_WEAR_THRESHOLD
+                         && flashfs_free_segments(ctx) > FLASHFS_GC_RESERVE);
+    uint32_t capacity = flashfs_record_limit(ctx, 1);
+    uint32_t victim = FLASHFS_NO_SEGMENT;
+    for (uint32_t i = 0; i < ctx->segment_count; i++) {
+        flashfs_segment_t* seg = &ctx->segments[i];
+        if (seg->state != FLASHFS_SEG_SEALED && seg->state != FLASHFS_SEG_UNSEALED) {
+            continue;
+        }
+        if (!wear_leveling && seg->live >= capacity) {
+            continue;
+        }
+        if (victim == FLASHFS_NO_SEGMENT) {
+            victim = i;
+            continue;
+        }
+        flashfs_segment_t* best = &ctx->segments[victim];
+        if (wear_leveling
+            ? (seg->erase_count < best->erase_count)
+            : (seg->live < best->live || (seg->live == best->live && seg->erase_count < best->erase_count))) {
+            victim = i;
+        }
+    }
+    if (victim == FLASHFS_NO_SEGMENT) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+
+    flashfs_summary_entry_t* entries;
+    uint32_t count;
+    uint32_t end;
+    int result = flashfs_load_entries(ctx, victim, &entries, &count, &end);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    uint8_t* buffer = (uint8_t*)Dmod_Malloc(ctx->sim.sector_size);
+    if (buffer == NULL) {
+        if (entries != NULL) {
+            Dmod_Free(entries);
+        }
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    ctx->in_gc = 1;
+    uint32_t base = victim * ctx->sim.sector_size;
+    for (uint32_t i = 0; i < count && result == DMFSI_OK; i++) {
+        flashfs_summary_entry_t* entry = &entries[i];
+        uint32_t type = FLASHFS_ENTRY_TYPE(entry);
+        flashfs_inode_t* inode = flashfs_find_ino(ctx, entry->ino);
+
+        if (type == FLASHFS_REC_INODE) {
+            if (inode != NULL && inode->rec_addr == entry->addr) {
+                result = flashfs_write_inode(ctx, inode, inode->name);
+                ctx->stats.gc_bytes_copied += inode->rec_size;
+            }
+        } else if (type == FLASHFS_REC_DELETE) {
+            if (flashfs_tombstone_needed(ctx, victim, entry->offset)) {
+                result = flashfs_write_delete(ctx, entry->ino, entry->offset);
+            }
+        } else if (type == FLASHFS_REC_DATA && inode != NULL) {
+            // Move every extent still pointing into this record, together with
+            // the file-contiguous extents around it, so that files split by
+            // earlier copies are merged back
+            uint32_t data_start = entry->addr + FLASHFS_HEADER_SIZE;
+            uint32_t data_end = data_start + FLASHFS_ENTRY_LENGTH(entry);
+            uint32_t max_length = flashfs_max_payload(ctx);
+            uint32_t n = 0;
+            while (n < inode->extent_count && result == DMFSI_OK) {
+                if (inode->extents[n].addr < data_start || inode->extents[n].addr >= data_end) {
+                    n++;
+                    continue;
+                }
+                uint32_t first = n;
+                uint32_t last = n;
+                uint32_t length = inode->extents[n].length;
+                while (first > 0
+                       && inode->extents[first - 1].offset + inode->extents[first - 1].length == inode->extents[first].offset
+                       && length + inode->extents[first - 1].length <= max_length) {
+                    first--;
+                    length += inode->extents[first].length;
+                }
+                while (last + 1 < inode->extent_count
+                       && inode->extents[last].offset + inode->extents[last].length == inode->extents[last + 1].offset
+                       && length + inode->extents[last + 1].length <= max_length) {
+                    last++;
+                    length += inode->extents[last].length;
+                }
+                uint32_t offset = inode->extents[first].offset;
+                result = flashfs_read_file(ctx, inode, offset, buffer, length);
+                if (result == DMFSI_OK) {
+                    result = flashfs_write_data(ctx, inode, offset, buffer, length);
+                    ctx->stats.gc_bytes_copied += length;
+                }
+                n = 0;
+            }
+        }
+    }
+    ctx->in_gc = 0;
+    Dmod_Free(buffer);
+    if (entries != NULL) {
+        Dmod_Free(entries);
+    }
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    if (ctx->segments[victim].live != 0) {
+        Dmod_Printf("FlashFS: %u live bytes left in collected segment at 0x%x\n",
+                    ctx->segments[victim].live, base);
+    }
+    ctx->stats.gc_runs++;
+
+    // The copies must be on the flash before the originals are gone
+    if (ctx->open_segment != FLASHFS_NO_SEGMENT) {
+        result = flashfs_flush_page(ctx, 1);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    }
+    return flashfs_erase_segment(ctx, victim);
+}
+
+// ----------------------------------------------------------------------------
+//  File handles
+// ----------------------------------------------------------------------------
+
+// Write the data coalesced in the handle to the log
+static int flashfs_handle_flush(dmfsi_context_t ctx, flashfs_handle_t* handle)
+{
+    if (handle->buffer_length == 0) {
+        return DMFSI_OK;
+    }
+    int result = flashfs_write_data(ctx, handle->inode, handle->buffer_offset,
+                                    handle->buffer, handle->buffer_length);
+    handle->buffer_length = 0;
+    return result;
+}
+
+// Size of the file seen through a handle, including its buffered data
+static uint32_t flashfs_handle_size(const flashfs_handle_t* handle)
+{
+    uint32_t size = handle->inode->size;
+    if (handle->buffer_length > 0 && handle->buffer_offset + handle->buffer_length > size) {
+        size = handle->buffer_offset + handle->buffer_length;
+    }
+    return size;
+}
+
+// Release the index and the device of a context
+static void flashfs_release(dmfsi_context_t ctx)
+{
+    flashfs_inode_t* inode = ctx->inodes;
+    while (inode != NULL) {
+        flashfs_inode_t* next = inode->next;
+        if (inode->extents != NULL) {
+            Dmod_Free(inode->extents);
+        }
+        if (inode->name != NULL) {
+            Dmod_Free(inode->name);
+        }
+        Dmod_Free(inode);
+        inode = next;
+    }
+    if (ctx->segments != NULL) {
+        Dmod_Free(ctx->segments);
+    }
+    if (ctx->summary != NULL) {
+        Dmod_Free(ctx->summary);
+    }
+    if (ctx->wbuf != NULL) {
+        Dmod_Free(ctx->wbuf);
+    }
+    flashfs_sim_close(&ctx->sim);
+    ctx->magic = 0xDEADBEEF;
+    Dmod_Free(ctx);
+}
+
+static void flashfs_fill_stat(const flashfs_inode_t* inode, dmfsi_stat_t* stat)
+{
+    stat->size = inode->size;
+    stat->attr = 0;
+    stat->ctime = 0;
+    stat->mtime = 0;
+    stat->atime = 0;
+}
+
+// Implement _init for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, dmfsi_context_t, _init, (const char* config) )
+{
+    Dmod_Printf("FlashFS: Initializing file system\n");
+
+    struct dmfsi_context* ctx = (struct dmfsi_context*)Dmod_Malloc(sizeof(struct dmfsi_context));
+    if (ctx == NULL) {
+        Dmod_Printf("FlashFS: Failed to allocate context\n");
+        return NULL;
+    }
+    flashfs_memset(ctx, 0, sizeof(*ctx));
+
+    if (flashfs_sim_open(&ctx->sim, config) != 0) {
+        Dmod_Free(ctx);
+        return NULL;
+    }
+    if (ctx->sim.sector_size > 0x00FFFFFFu) {
+        Dmod_Printf("FlashFS: Sector size too large\n");
+        flashfs_sim_close(&ctx->sim);
+        Dmod_Free(ctx);
+        return NULL;
+    }
+
+    ctx->magic = FLASHFS_CONTEXT_MAGIC;
+    ctx->segment_count = ctx->sim.size / ctx->sim.sector_size;
+    ctx->open_segment = FLASHFS_NO_SEGMENT;
+    ctx->summary_capacity = (ctx->sim.sector_size - sizeof(flashfs_segment_header_t))
+                          / (FLASHFS_HEADER_SIZE + sizeof(flashfs_summary_entry_t));
+    ctx->segments = (flashfs_segment_t*)Dmod_Malloc(ctx->segment_count * sizeof(flashfs_segment_t));
+    ctx->summary = (flashfs_summary_entry_t*)Dmod_Malloc(ctx->summary_capacity * sizeof(flashfs_summary_entry_t));
+    ctx->wbuf = (uint8_t*)Dmod_Malloc(ctx->sim.page_size);
+
+    if (ctx->segment_count <= FLASHFS_GC_RESERVE + 1
+        || ctx->segments == NULL || ctx->summary == NULL || ctx->wbuf == NULL
+        || flashfs_mount(ctx) != DMFSI_OK) {
+        Dmod_Printf("FlashFS: Failed to mount\n");
+        flashfs_release(ctx);
+        return NULL;
+    }
+
+    Dmod_Printf("FlashFS: Mounted in %u us (simulated), %u records, %u summaries, %u scans\n",
+                ctx->stats.mount_time_us, ctx->stats.mount_records,
+                ctx->stats.mount_summaries, ctx->stats.mount_scans);
+    return ctx;
+}
+
+// Implement _deinit for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _deinit, (dmfsi_context_t ctx) )
+{
+    Dmod_Printf("FlashFS: Deinitializing file system\n");
+
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    int result = DMFSI_OK;
+    if (ctx->open_segment != FLASHFS_NO_SEGMENT) {
+        result = flashfs_flush_page(ctx, 1);
+    }
+    flashfs_release(ctx);
+    return result;
+}
+
+// Implement _context_is_valid for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _context_is_valid, (dmfsi_context_t ctx) )
+{
+    return (ctx != NULL && ctx->magic == FLASHFS_CONTEXT_MAGIC) ? 1 : 0;
+}
+
+// Implement _fopen for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fopen, (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr) )
+{
+    Dmod_Printf("FlashFS: Opening file '%s' with mode 0x%x\n", path, mode);
+
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (flashfs_strlen(path) > FLASHFS_MAX_NAME) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    flashfs_handle_t* handle = (flashfs_handle_t*)Dmod_Malloc(sizeof(flashfs_handle_t));
+    if (handle == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    int result = DMFSI_OK;
+    flashfs_inode_t* inode = flashfs_find_name(ctx, path);
+    if (inode == NULL) {
+        if (!(mode & DMFSI_O_CREAT)) {
+            result = DMFSI_ERR_NOT_FOUND;
+        } else {
+            inode = flashfs_new_inode(ctx, ctx->next_ino, flashfs_current_seq(ctx));
+            result = (inode == NULL) ? DMFSI_ERR_NO_SPACE : flashfs_write_inode(ctx, inode, path);
+            if (result != DMFSI_OK && inode != NULL) {
+                flashfs_remove_inode(ctx, inode);
+            }
+        }
+    } else if ((mode & DMFSI_O_TRUNC) && (mode & DMFSI_O_WRONLY)) {
+        // Continue as a new inode, the old records become dead
+        result = flashfs_write_delete(ctx, inode->ino, inode->first_seq);
+        if (result == DMFSI_OK) {
+            flashfs_clear_extents(ctx, inode);
+            inode->ino = ctx->next_ino++;
+            inode->first_seq = flashfs_current_seq(ctx);
+            result = flashfs_write_inode(ctx, inode, path);
+        }
+    }
+    if (result != DMFSI_OK) {
+        Dmod_Free(handle);
+        return result;
+    }
+
+    handle->inode = inode;
+    handle->mode = mode;
+    handle->position = (mode & DMFSI_O_APPEND) ? inode->size : 0;
+    handle->buffer_length = 0;
+    handle->buffer_offset = 0;
+    *fp = handle;
+    return DMFSI_OK;
+}
+
+// Implement _fclose for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fclose, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    int result = flashfs_handle_flush(ctx, (flashfs_handle_t*)fp);
+    Dmod_Free(fp);
+    return result;
+}
+
+// Implement _fread for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fread, (dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read) )
+{
+    if (!FLASHFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    flashfs_handle_t* handle = (flashfs_handle_t*)fp;
+    *read = 0;
+    int result = flashfs_handle_flush(ctx, handle);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    uint32_t size_of_file = handle->inode->size;
+    size_t available = (handle->position < size_of_file) ? size_of_file - handle->position : 0;
+    uint32_t to_read = (uint32_t)((size < available) ? size : available);
+    if (to_read > 0) {
+        result = flashfs_read_file(ctx, handle->inode, handle->position, (uint8_t*)buffer, to_read);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        handle->position += to_read;
+    }
+    *read = to_read;
+    return DMFSI_OK;
+}
+
+// Implement _fwrite for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fwrite, (dmfsi_context_t ctx, void* fp, const void* buffer, size_t size, size_t* written) )
+{
+    if (!FLASHFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    flashfs_handle_t* handle = (flashfs_handle_t*)fp;
+    const uint8_t* data = (const uint8_t*)buffer;
+    int result = DMFSI_OK;
+    *written = 0;
+
+    if (handle->mode & DMFSI_O_APPEND) {
+        uint32_t end = handle->buffer_length ? handle->buffer_offset + handle->buffer_length : 0;
+        handle->position = (handle->inode->size > end) ? handle->inode->size : end;
+    }
+    if ((size_t)handle->position + size > 0xFFFFFFFFu) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    // Small sequential writes are coalesced into one record
+    if (handle->buffer_length > 0 && handle->buffer_offset + handle->buffer_length != handle->position) {
+        result = flashfs_handle_flush(ctx, handle);
+    }
+    if (result == DMFSI_OK && size >= FLASHFS_HANDLE_BUFFER) {
+        result = flashfs_handle_flush(ctx, handle);
+        if (result == DMFSI_OK) {
+            result = flashfs_write_data(ctx, handle->inode, handle->position, data, (uint32_t)size);
+        }
+    } else if (result == DMFSI_OK) {
+        if (handle->buffer_length + size > FLASHFS_HANDLE_BUFFER) {
+            result = flashfs_handle_flush(ctx, handle);
+        }
+        if (result == DMFSI_OK) {
+            if (handle->buffer_length == 0) {
+                handle->buffer_offset = handle->position;
+            }
+            flashfs_memcpy(handle->buffer + handle->buffer_length, data, size);
+            handle->buffer_length += (uint32_t)size;
+        }
+    }
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    handle->position += (uint32_t)size;
+    ctx->stats.user_bytes_written += size;
+    *written = size;
+    return DMFSI_OK;
+}
+
+// Implement _lseek for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, long, _lseek, (dmfsi_context_t ctx, void* fp, long offset, int whence) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    flashfs_handle_t* handle = (flashfs_handle_t*)fp;
+    int result = flashfs_handle_flush(ctx, handle);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+
+    long new_pos;
+    switch (whence) {
+        case DMFSI_SEEK_SET:
+            new_pos = offset;
+            break;
+        case DMFSI_SEEK_CUR:
+            new_pos = (long)handle->position + offset;
+            break;
+        case DMFSI_SEEK_END:
+            new_pos = (long)handle->inode->size + offset;
+            break;
+        default:
+            return DMFSI_ERR_INVALID;
+    }
+    if (new_pos < 0 || (unsigned long)new_pos > 0xFFFFFFFFu) {
+        return DMFSI_ERR_INVALID;
+    }
+    handle->position = (uint32_t)new_pos;
+    return new_pos;
+}
+
+// Implement _ioctl for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _ioctl, (dmfsi_context_t ctx, void* fp, int request, void* arg) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    switch (request) {
+        case FLASHFS_IOCTL_GET_STATS: {
+            flashfs_stats_t* stats = (flashfs_stats_t*)arg;
+            if (stats == NULL) {
+                return DMFSI_ERR_INVALID;
+            }
+            *stats = ctx->stats;
+            stats->flash_bytes_programmed = ctx->sim.bytes_programmed;
+            stats->flash_bytes_read = ctx->sim.bytes_read;
+            stats->device_time_us = ctx->sim.time_us;
+            stats->free_segments = flashfs_free_segments(ctx);
+            stats->min_erase_count = 0xFFFFFFFFu;
+            stats->max_erase_count = 0;
+            for (uint32_t i = 0; i < ctx->segment_count; i++) {
+                uint32_t count = ctx->segments[i].erase_count;
+                stats->min_erase_count = (count < stats->min_erase_count) ? count : stats->min_erase_count;
+                stats->max_erase_count = (count > stats->max_erase_count) ? count : stats->max_erase_count;
+            }
+            return DMFSI_OK;
+        }
+        case FLASHFS_IOCTL_GC_STEP:
+            return flashfs_gc_step(ctx);
+        default:
+            Dmod_Printf("FlashFS: ioctl request %d not supported\n", request);
+            return DMFSI_ERR_GENERAL;
+    }
+}
+
+// Implement _sync for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _sync, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    int result = (fp != NULL) ? flashfs_handle_flush(ctx, (flashfs_handle_t*)fp) : DMFSI_OK;
+
+    // Background garbage collection - one segment per sync while space gets low
+    if (result == DMFSI_OK && flashfs_free_segments(ctx) < FLASHFS_GC_BACKGROUND) {
+        flashfs_gc_step(ctx);
+    }
+    if (result == DMFSI_OK && ctx->open_segment != FLASHFS_NO_SEGMENT) {
+        result = flashfs_flush_page(ctx, 1);
+    }
+    return result;
+}
+
+// Implement _getc for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _getc, (dmfsi_context_t ctx, void* fp) )
+{
+    uint8_t c;
+    size_t read;
+    int result = dmfsi_flashfs_fread(ctx, fp, &c, 1, &read);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    return (read == 1) ? c : -1;
+}
+
+// Implement _putc for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _putc, (dmfsi_context_t ctx, void* fp, int c) )
+{
+    uint8_t ch = (uint8_t)c;
+    size_t written;
+    int result = dmfsi_flashfs_fwrite(ctx, fp, &ch, 1, &written);
+    if (result != DMFSI_OK || written != 1) {
+        return -1;
+    }
+    return c;
+}
+
+// Implement _tell for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, long, _tell, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!FLASHFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    return (long)((flashfs_handle_t*)fp)->position;
+}
+
+// Implement _eof for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _eof, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!FLASHFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    flashfs_handle_t* handle = (flashfs_handle_t*)fp;
+    return (handle->position >= flashfs_handle_size(handle)) ? 1 : 0;
+}
+
+// Implement _size for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, long, _size, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!FLASHFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    return (long)flashfs_handle_size((flashfs_handle_t*)fp);
+}
+
+// Implement _fflush for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fflush, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    return flashfs_handle_flush(ctx, (flashfs_handle_t*)fp);
+}
+
+// Implement _error for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _error, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    return DMFSI_OK;
+}
+
+// Implement _opendir for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _opendir, (dmfsi_context_t ctx, void** dp, const char* path) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // The namespace is flat - a directory lists the files with its path as prefix
+    size_t len = flashfs_strlen(path);
+    if (len > FLASHFS_MAX_NAME) {
+        return DMFSI_ERR_INVALID;
+    }
+    flashfs_dir_t* dir = (flashfs_dir_t*)Dmod_Malloc(sizeof(flashfs_dir_t));
+    if (dir == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    flashfs_memcpy(dir->path, path, len + 1);
+    dir->next = ctx->inodes;
+    *dp = dir;
+    return DMFSI_OK;
+}
+
+// Implement _closedir for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _closedir, (dmfsi_context_t ctx, void* dp) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    Dmod_Free(dp);
+    return DMFSI_OK;
+}
+
+// Implement _readdir for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _readdir, (dmfsi_context_t ctx, void* dp, dmfsi_dir_entry_t* entry) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    flashfs_dir_t* dir = (flashfs_dir_t*)dp;
+    while (dir->next != NULL) {
+        flashfs_inode_t* inode = dir->next;
+        dir->next = inode->next;
+
+        const char* p = dir->path;
+        const char* n = inode->name;
+        while (*p && *p == *n) {
+            p++;
+            n++;
+        }
+        if (*p != '\0') {
+            continue;
+        }
+
+        size_t len = flashfs_strlen(inode->name);
+        if (len > sizeof(entry->name) - 1) {
+            len = sizeof(entry->name) - 1;
+        }
+        flashfs_memcpy(entry->name, inode->name, len);
+        entry->name[len] = '\0';
+        entry->size = inode->size;
+        entry->attr = 0;
+        entry->time = 0;
+        return DMFSI_OK;
+    }
+    return DMFSI_ERR_NOT_FOUND;
+}
+
+// Implement _stat for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _stat, (dmfsi_context_t ctx, const char* path, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    flashfs_inode_t* inode = flashfs_find_name(ctx, path);
+    if (inode == NULL) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    flashfs_fill_stat(inode, stat);
+    return DMFSI_OK;
+}
+
+// Implement _fstat for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _fstat, (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || fp == NULL || stat == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    flashfs_fill_stat(((flashfs_handle_t*)fp)->inode, stat);
+    stat->size = flashfs_handle_size((flashfs_handle_t*)fp);
+    return DMFSI_OK;
+}
+
+// Implement _stat_many for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _stat_many, (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC || paths == NULL || stats == NULL || results == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        flashfs_inode_t* inode = flashfs_find_name(ctx, paths[i]);
+        results[i] = (inode != NULL) ? DMFSI_OK : DMFSI_ERR_NOT_FOUND;
+        if (inode != NULL) {
+            flashfs_fill_stat(inode, &stats[i]);
+            found++;
+        }
+    }
+    return found;
+}
+
+// Implement _unlink for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _unlink, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    Dmod_Printf("FlashFS: unlink '%s'\n", path);
+
+    flashfs_inode_t* inode = flashfs_find_name(ctx, path);
+    if (inode == NULL) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    int result = flashfs_write_delete(ctx, inode->ino, inode->first_seq);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    flashfs_remove_inode(ctx, inode);
+    return DMFSI_OK;
+}
+
+// Implement _rename for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _rename, (dmfsi_context_t ctx, const char* oldpath, const char* newpath) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    Dmod_Printf("FlashFS: rename '%s' to '%s'\n", oldpath, newpath);
+
+    flashfs_inode_t* inode = flashfs_find_name(ctx, oldpath);
+    if (inode == NULL) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    if (flashfs_find_name(ctx, newpath) != NULL) {
+        return DMFSI_ERR_EXISTS;
+    }
+    if (flashfs_strlen(newpath) > FLASHFS_MAX_NAME) {
+        return DMFSI_ERR_INVALID;
+    }
+    return flashfs_write_inode(ctx, inode, newpath);
+}
+
+// Implement _chmod for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _chmod, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    Dmod_Printf("FlashFS: chmod '%s' mode=%d (not implemented)\n", path, mode);
+    return DMFSI_OK;
+}
+
+// Implement _utime for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _utime, (dmfsi_context_t ctx, const char* path, uint32_t atime, uint32_t mtime) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    Dmod_Printf("FlashFS: utime '%s' (not implemented)\n", path);
+    return DMFSI_OK;
+}
+
+// Implement _mkdir for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _mkdir, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // Directories are implied by the file names
+    return DMFSI_OK;
+}
+
+// Implement _direxists for FlashFS
+dmod_dmfsi_dif_api_declaration( 1.0, flashfs, int, _direxists, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != FLASHFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    for (flashfs_inode_t* inode = ctx->inodes; inode != NULL; inode = inode->next) {
+        const char* p = path;
+        const char* n = inode->name;
+        while (*p && *p == *n) {
+            p++;
+            n++;
+        }
+        if (*p == '\0' && (*n == '/' || (p > path && p[-1] == '/'))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int dmod_init(const Dmod_Config_t *Config)
+{
+    Dmod_Printf("FlashFS module initialized\n");
+    return 0;
+}
+
+int dmod_deinit(void)
+{
+    Dmod_Printf("FlashFS module deinitialized\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef FLASHFS_H
+#define FLASHFS_H
+
+#include <stdint.h>
+
+/**
+ * @brief FlashFS - Log-structured flash file system
+ *
+ * Requests accepted by the _ioctl of FlashFS (the file handle is not used).
+ */
+
+/**
+ * @brief Get the statistics of the file system, arg is flashfs_stats_t*
+ */
+#define FLASHFS_IOCTL_GET_STATS     0x4601
+
+/**
+ * @brief Run a single garbage collection step, arg is unused
+ *
+ * Returns DMFSI_OK if a segment was reclaimed, DMFSI_ERR_NOT_FOUND if
+ * there was nothing worth collecting.
+ */
+#define FLASHFS_IOCTL_GC_STEP       0x4602
+
+/**
+ * @brief FlashFS statistics
+ *
+ * Device times are taken from the simulated clock of the flash device, so
+ * they are deterministic for a given workload and configuration. The write
+ * amplification is flash_bytes_programmed / user_bytes_written and the
+ * sustained write throughput is user_bytes_written / device_time_us.
+ */
+typedef struct {
+    uint64_t user_bytes_written;        // Bytes passed to _fwrite/_putc
+    uint64_t flash_bytes_programmed;    // Bytes programmed to the device
+    uint64_t flash_bytes_read;          // Bytes read from the device
+    uint64_t device_time_us;            // Total simulated device time
+    uint64_t gc_bytes_copied;           // Live bytes moved by garbage collection
+    uint32_t gc_runs;                   // Segments reclaimed
+    uint32_t erases;                    // Sector erases since init
+    uint32_t min_erase_count;           // Lowest erase count of a segment
+    uint32_t max_erase_count;           // Highest erase count of a segment
+    uint32_t free_segments;             // Segments ready to be written
+    uint32_t mount_time_us;             // Simulated device time of the mount
+    uint32_t mount_records;             // Records replayed at mount
+    uint32_t mount_summaries;           // Segments indexed from their summary
+    uint32_t mount_scans;               // Segments indexed by scanning records
+} flashfs_stats_t;
+
+#endif // FLASHFS_H
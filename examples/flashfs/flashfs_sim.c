@@ -0,0 +1,252 @@
+#include "dmod.h"
+#include "flashfs_sim.h"
+
+#define FLASHFS_SIM_SEEK_SET    0
+#define FLASHFS_SIM_MAX_PATH    128
+
+const char* flashfs_config_find(const char* config, const char* key)
+{
+    const char* p = config;
+    while (p != NULL && *p) {
+        const char* k = key;
+        const char* v = p;
+        while (*k && *v == *k) {
+            k++;
+            v++;
+        }
+        if (*k == '\0' && *v == '=') {
+            return v + 1;
+        }
+        while (*p && *p != ';') {
+            p++;
+        }
+        if (*p == ';') {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+uint32_t flashfs_config_u32(const char* config, const char* key, uint32_t def)
+{
+    const char* v = flashfs_config_find(config, key);
+    if (v == NULL || *v < '0' || *v > '9') {
+        return def;
+    }
+    uint32_t value = 0;
+    while (*v >= '0' && *v <= '9') {
+        value = value * 10 + (uint32_t)(*v - '0');
+        v++;
+    }
+    if (*v == 'k' || *v == 'K') {
+        value *= 1024;
+    } else if (*v == 'm' || *v == 'M') {
+        value *= 1024 * 1024;
+    }
+    return value;
+}
+
+// Helper function to compare the value of an option with a string
+static int flashfs_sim_config_is(const char* config, const char* key, const char* expected)
+{
+    const char* v = flashfs_config_find(config, key);
+    if (v == NULL) {
+        return 0;
+    }
+    while (*expected && *v == *expected) {
+        v++;
+        expected++;
+    }
+    return *expected == '\0' && (*v == '\0' || *v == ';');
+}
+
+// Helper function to account the latency of an operation on `size` bytes
+static void flashfs_sim_account(flashfs_sim_t* sim, uint32_t size, uint32_t us_per_page)
+{
+    uint32_t pages = (size + sim->page_size - 1) / sim->page_size;
+    sim->time_us += (uint64_t)pages * us_per_page;
+}
+
+// Helper function to fill a range of the host file with the erased value
+static int flashfs_sim_fill_erased(flashfs_sim_t* sim, uint32_t addr, uint32_t size)
+{
+    for (uint32_t i = 0; i < sim->page_size; i++) {
+        sim->page_buffer[i] = 0xFF;
+    }
+    if (Dmod_FileSeek(sim->file, (long)addr, FLASHFS_SIM_SEEK_SET) != 0) {
+        return -1;
+    }
+    for (uint32_t done = 0; done < size; done += sim->page_size) {
+        if (Dmod_FileWrite(sim->page_buffer, 1, sim->page_size, sim->file) != sim->page_size) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int flashfs_sim_open(flashfs_sim_t* sim, const char* config)
+{
+    char path[FLASHFS_SIM_MAX_PATH];
+    sim->file = NULL;
+    sim->erase_counts = NULL;
+    sim->page_buffer = NULL;
+
+    const char* v = flashfs_config_find(config, "file");
+    if (v == NULL) {
+        Dmod_Printf("FlashFS: 'file' option is required\n");
+        return -1;
+    }
+    size_t len = 0;
+    while (v[len] && v[len] != ';' && len < sizeof(path) - 1) {
+        path[len] = v[len];
+        len++;
+    }
+    path[len] = '\0';
+
+    sim->type = flashfs_sim_config_is(config, "type", "nand") ? FLASHFS_SIM_NAND : FLASHFS_SIM_NOR;
+    if (sim->type == FLASHFS_SIM_NAND) {
+        sim->sector_size = flashfs_config_u32(config, "sector", 128 * 1024);
+        sim->page_size   = flashfs_config_u32(config, "page", 2048);
+        sim->erase_us    = flashfs_config_u32(config, "erase_us", 2000);
+        sim->program_us  = flashfs_config_u32(config, "program_us", 250);
+        sim->read_us     = flashfs_config_u32(config, "read_us", 25);
+    } else {
+        sim->sector_size = flashfs_config_u32(config, "sector", 4 * 1024);
+        sim->page_size   = flashfs_config_u32(config, "page", 256);
+        sim->erase_us    = flashfs_config_u32(config, "erase_us", 45000);
+        sim->program_us  = flashfs_config_u32(config, "program_us", 700);
+        sim->read_us     = flashfs_config_u32(config, "read_us", 5);
+    }
+    sim->size = flashfs_config_u32(config, "size", 1024 * 1024);
+    sim->time_us = 0;
+    sim->bytes_read = 0;
+    sim->bytes_programmed = 0;
+
+    if (sim->page_size == 0 || sim->sector_size % sim->page_size != 0
+        || sim->sector_size == 0 || sim->size % sim->sector_size != 0) {
+        Dmod_Printf("FlashFS: Invalid flash geometry\n");
+        return -1;
+    }
+
+    uint32_t sectors = sim->size / sim->sector_size;
+    sim->erase_counts = (uint32_t*)Dmod_Malloc(sectors * sizeof(uint32_t));
+    sim->page_buffer = (uint8_t*)Dmod_Malloc(sim->page_size);
+    if (sim->erase_counts == NULL || sim->page_buffer == NULL) {
+        flashfs_sim_close(sim);
+        return -1;
+    }
+    for (uint32_t i = 0; i < sectors; i++) {
+        sim->erase_counts[i] = 0;
+    }
+
+    sim->file = Dmod_FileOpen(path, "r+b");
+    if (sim->file != NULL && Dmod_FileSize(sim->file) != sim->size) {
+        Dmod_Printf("FlashFS: '%s' does not match the device size, recreating\n", path);
+        Dmod_FileClose(sim->file);
+        sim->file = NULL;
+    }
+    if (sim->file == NULL) {
+        sim->file = Dmod_FileOpen(path, "w+b");
+        if (sim->file == NULL || flashfs_sim_fill_erased(sim, 0, sim->size) != 0) {
+            Dmod_Printf("FlashFS: Cannot create device file '%s'\n", path);
+            flashfs_sim_close(sim);
+            return -1;
+        }
+    }
+
+    Dmod_Printf("FlashFS: %s device '%s', %u bytes, sector %u, page %u\n",
+                sim->type == FLASHFS_SIM_NAND ? "NAND" : "NOR", path,
+                sim->size, sim->sector_size, sim->page_size);
+    return 0;
+}
+
+void flashfs_sim_close(flashfs_sim_t* sim)
+{
+    if (sim->file != NULL) {
+        Dmod_FileClose(sim->file);
+        sim->file = NULL;
+    }
+    if (sim->erase_counts != NULL) {
+        Dmod_Free(sim->erase_counts);
+        sim->erase_counts = NULL;
+    }
+    if (sim->page_buffer != NULL) {
+        Dmod_Free(sim->page_buffer);
+        sim->page_buffer = NULL;
+    }
+}
+
+int flashfs_sim_read(flashfs_sim_t* sim, uint32_t addr, void* buffer, uint32_t size)
+{
+    if (addr > sim->size || size > sim->size - addr) {
+        return -1;
+    }
+    if (Dmod_FileSeek(sim->file, (long)addr, FLASHFS_SIM_SEEK_SET) != 0) {
+        return -1;
+    }
+    if (Dmod_FileRead(buffer, 1, size, sim->file) != size) {
+        return -1;
+    }
+    sim->bytes_read += size;
+    flashfs_sim_account(sim, size, sim->read_us);
+    return 0;
+}
+
+int flashfs_sim_program(flashfs_sim_t* sim, uint32_t addr, const void* buffer, uint32_t size)
+{
+    const uint8_t* data = (const uint8_t*)buffer;
+    if (addr > sim->size || size > sim->size - addr) {
+        return -1;
+    }
+    if (sim->type == FLASHFS_SIM_NAND && (addr % sim->page_size != 0 || size % sim->page_size != 0)) {
+        Dmod_Printf("FlashFS: NAND program of a partial page at 0x%x\n", addr);
+        return -1;
+    }
+
+    // Program page by page, applying the rules of the device
+    for (uint32_t done = 0; done < size; ) {
+        uint32_t page_addr = addr + done;
+        uint32_t chunk = sim->page_size - (page_addr % sim->page_size);
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+
+        if (Dmod_FileSeek(sim->file, (long)page_addr, FLASHFS_SIM_SEEK_SET) != 0
+            || Dmod_FileRead(sim->page_buffer, 1, chunk, sim->file) != chunk) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (sim->type == FLASHFS_SIM_NAND) {
+                if (sim->page_buffer[i] != 0xFF) {
+                    Dmod_Printf("FlashFS: NAND page at 0x%x programmed twice\n", page_addr);
+                    return -1;
+                }
+                sim->page_buffer[i] = data[done + i];
+            } else {
+                sim->page_buffer[i] &= data[done + i];
+            }
+        }
+        if (Dmod_FileSeek(sim->file, (long)page_addr, FLASHFS_SIM_SEEK_SET) != 0
+            || Dmod_FileWrite(sim->page_buffer, 1, chunk, sim->file) != chunk) {
+            return -1;
+        }
+        done += chunk;
+    }
+
+    sim->bytes_programmed += size;
+    flashfs_sim_account(sim, size, sim->program_us);
+    return 0;
+}
+
+int flashfs_sim_erase(flashfs_sim_t* sim, uint32_t sector)
+{
+    if (sector >= sim->size / sim->sector_size) {
+        return -1;
+    }
+    if (flashfs_sim_fill_erased(sim, sector * sim->sector_size, sim->sector_size) != 0) {
+        return -1;
+    }
+    sim->erase_counts[sector]++;
+    sim->time_us += sim->erase_us;
+    return 0;
+}
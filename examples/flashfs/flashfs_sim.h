@@ -0,0 +1,105 @@
+#ifndef FLASHFS_SIM_H
+#define FLASHFS_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Simulated NOR/NAND flash device backed by a host file
+ *
+ * The device content is kept in a regular file, so it survives between runs
+ * and can be mounted again. The simulator enforces the flash programming
+ * rules and accounts the latency of every operation in a simulated clock,
+ * so that results are deterministic and do not depend on the host speed:
+ *
+ *  - NOR:  bytes can be programmed many times, but bits only go from 1 to 0
+ *  - NAND: a page is programmed as a whole, once between erases
+ */
+
+#define FLASHFS_SIM_NOR     0
+#define FLASHFS_SIM_NAND    1
+
+typedef struct {
+    void* file;                 // Host file with the device content
+    int type;                   // FLASHFS_SIM_NOR or FLASHFS_SIM_NAND
+    uint32_t size;              // Device size in bytes
+    uint32_t sector_size;       // Erase unit in bytes
+    uint32_t page_size;         // Program unit in bytes
+    uint32_t erase_us;          // Latency of a sector erase
+    uint32_t program_us;        // Latency of a page program
+    uint32_t read_us;           // Latency of a page read
+    uint64_t time_us;           // Simulated time spent in device operations
+    uint64_t bytes_read;        // Bytes read from the device
+    uint64_t bytes_programmed;  // Bytes programmed to the device
+    uint32_t* erase_counts;     // Number of erases of each sector
+    uint8_t* page_buffer;       // Scratch buffer of one page
+} flashfs_sim_t;
+
+/**
+ * @brief Open the simulated device
+ *
+ * The config string uses the same `key=value;` form as the file system:
+ * file, type (nor/nand), size, sector, page, erase_us, program_us, read_us.
+ * A missing host file is created in the erased state.
+ *
+ * @param sim Simulator to initialize
+ * @param config Configuration string
+ * @return 0 on success, negative value otherwise
+ */
+int flashfs_sim_open(flashfs_sim_t* sim, const char* config);
+
+/**
+ * @brief Close the simulated device
+ * @param sim Simulator
+ */
+void flashfs_sim_close(flashfs_sim_t* sim);
+
+/**
+ * @brief Read from the device
+ * @param sim Simulator
+ * @param addr Address to read from
+ * @param buffer Buffer to read into
+ * @param size Number of bytes to read
+ * @return 0 on success, negative value otherwise
+ */
+int flashfs_sim_read(flashfs_sim_t* sim, uint32_t addr, void* buffer, uint32_t size);
+
+/**
+ * @brief Program the device
+ *
+ * For NAND the range must cover whole pages that are erased.
+ *
+ * @param sim Simulator
+ * @param addr Address to program
+ * @param buffer Data to program
+ * @param size Number of bytes to program
+ * @return 0 on success, negative value if the programming rules are violated
+ */
+int flashfs_sim_program(flashfs_sim_t* sim, uint32_t addr, const void* buffer, uint32_t size);
+
+/**
+ * @brief Erase a sector (all bytes become 0xFF)
+ * @param sim Simulator
+ * @param sector Sector index
+ * @return 0 on success, negative value otherwise
+ */
+int flashfs_sim_erase(flashfs_sim_t* sim, uint32_t sector);
+
+/**
+ * @brief Find the value of an option in a `key=value;` config string
+ * @param config Configuration string
+ * @param key Option name
+ * @return Pointer to the value, or NULL if the option is not present
+ */
+const char* flashfs_config_find(const char* config, const char* key);
+
+/**
+ * @brief Parse a numeric option with an optional k/m suffix
+ * @param config Configuration string
+ * @param key Option name
+ * @param def Value used when the option is not present
+ * @return Option value
+ */
+uint32_t flashfs_config_u32(const char* config, const char* key, uint32_t def);
+
+#endif // FLASHFS_SIM_H
@@ -0,0 +1,184 @@
+/**
+ * @brief flashfs_wear - run a wear workload on the FlashFS simulator
+ *
+ * Usage: flashfs_wear [-c config] [-n rewrites]
+ *
+ *   -c config   config string of FlashFS, a 256 KiB NOR device in
+ *               flashfs_wear.bin by default (the file is recreated)
+ *   -n rewrites rewrites of the hot file (20000 by default)
+ *
+ * The workload fills about half of the device with static files, then
+ * rewrites a small hot file over and over with a _sync after each one,
+ * the case where wear leveling has to move the static data. The static
+ * files are checked, the device is mounted again, and the statistics of
+ * FLASHFS_IOCTL_GET_STATS are printed: write amplification, garbage
+ * collection, the erases and the spread of the erase counts, and the
+ * mount. The exit status is not zero when an operation or the check fails.
+ *
+ * Built with the examples in DMOD_SYSTEM mode, it links FlashFS statically
+ * (see DMFSI_STATIC_OPS).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dmod.h"
+#include "dmfsi.h"
+#include "flashfs.h"
+#include "flashfs_sim.h"
+
+#define WEAR_STATIC_FILES   40
+#define WEAR_STATIC_SIZE    3000
+#define WEAR_HOT_SIZE       600
+
+DMFSI_DECLARE_STATIC_IMPL(flashfs)
+
+static dmfsi_ops_t ops;
+static unsigned char buffer[WEAR_STATIC_SIZE];
+
+static int write_file(dmfsi_context_t ctx, const char* path, int fill, size_t size)
+{
+    void* fp;
+    size_t written = 0;
+    int result = ops.fopen(ctx, &fp, path, DMFSI_O_WRONLY | DMFSI_O_CREAT | DMFSI_O_TRUNC, 0);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    memset(buffer, fill, size);
+    result = ops.fwrite(ctx, fp, buffer, size, &written);
+    ops.fclose(ctx, fp);
+    return (result == DMFSI_OK && written != size) ? DMFSI_ERR_NO_SPACE : result;
+}
+
+static int check_file(dmfsi_context_t ctx, const char* path, int fill, size_t size)
+{
+    void* fp;
+    size_t read = 0;
+    if (ops.fopen(ctx, &fp, path, DMFSI_O_RDONLY, 0) != DMFSI_OK) {
+        return 0;
+    }
+    int result = ops.fread(ctx, fp, buffer, size, &read);
+    ops.fclose(ctx, fp);
+    if (result != DMFSI_OK || read != size) {
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] != (unsigned char)fill) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void print_stats(const flashfs_stats_t* stats)
+{
+    double amplification = stats->user_bytes_written
+        ? (double)stats->flash_bytes_programmed / (double)stats->user_bytes_written : 0.0;
+    double throughput = stats->device_time_us
+        ? (double)stats->user_bytes_written / (double)stats->device_time_us * 1e6 / 1024.0 : 0.0;
+    printf("  user bytes written     %llu\n", (unsigned long long)stats->user_bytes_written);
+    printf("  flash bytes programmed %llu\n", (unsigned long long)stats->flash_bytes_programmed);
+    printf("  write amplification    %.2f\n", amplification);
+    printf("  write throughput       %.1f KiB/s of device time\n", throughput);
+    printf("  gc runs                %u (%llu bytes copied)\n", stats->gc_runs,
+           (unsigned long long)stats->gc_bytes_copied);
+    printf("  erases                 %u\n", stats->erases);
+    printf("  erase counts           %u to %u (spread %u)\n", stats->min_erase_count,
+           stats->max_erase_count, stats->max_erase_count - stats->min_erase_count);
+    printf("  free segments          %u\n", stats->free_segments);
+}
+
+int main(int argc, char** argv)
+{
+    const char* config = "file=flashfs_wear.bin;type=nor;size=256k";
+    long rewrites = 20000;
+
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc) {
+            config = argv[++arg];
+        } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            rewrites = atol(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || rewrites < 0) {
+        fprintf(stderr, "Usage: %s [-c config] [-n rewrites]\n", argv[0]);
+        return 1;
+    }
+
+    // Start from an erased device
+    const char* file = flashfs_config_find(config, "file");
+    if (file != NULL) {
+        char name[256];
+        size_t length = strcspn(file, ";");
+        if (length < sizeof(name)) {
+            memcpy(name, file, length);
+            name[length] = '\0';
+            remove(name);
+        }
+    }
+
+    ops = DMFSI_STATIC_OPS(flashfs);
+    dmfsi_context_t ctx = ops.init(config);
+    if (ctx == NULL) {
+        fprintf(stderr, "flashfs_wear: cannot initialize FlashFS with '%s'\n", config);
+        return 1;
+    }
+
+    char path[32];
+    for (int i = 0; i < WEAR_STATIC_FILES; i++) {
+        snprintf(path, sizeof(path), "/static%d", i);
+        if (write_file(ctx, path, i, WEAR_STATIC_SIZE) != DMFSI_OK) {
+            fprintf(stderr, "flashfs_wear: cannot write %s\n", path);
+            return 1;
+        }
+    }
+    for (long i = 0; i < rewrites; i++) {
+        if (write_file(ctx, "/hot", (int)i, WEAR_HOT_SIZE) != DMFSI_OK) {
+            fprintf(stderr, "flashfs_wear: cannot rewrite /hot, rewrite %ld\n", i);
+            return 1;
+        }
+        ops.sync(ctx, NULL);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < WEAR_STATIC_FILES; i++) {
+        snprintf(path, sizeof(path), "/static%d", i);
+        if (!check_file(ctx, path, i, WEAR_STATIC_SIZE)) {
+            fprintf(stderr, "flashfs_wear: %s does not read back\n", path);
+            failed = 1;
+        }
+    }
+
+    flashfs_stats_t stats;
+    ops.ioctl(ctx, NULL, FLASHFS_IOCTL_GET_STATS, &stats);
+    printf("%d static files of %d bytes, %ld rewrites of %d bytes\n",
+           WEAR_STATIC_FILES, WEAR_STATIC_SIZE, rewrites, WEAR_HOT_SIZE);
+    print_stats(&stats);
+    ops.deinit(ctx);
+
+    // Mount again, the time and the work of the mount are counted from init
+    ctx = ops.init(config);
+    if (ctx == NULL) {
+        fprintf(stderr, "flashfs_wear: cannot mount again\n");
+        return 1;
+    }
+    ops.ioctl(ctx, NULL, FLASHFS_IOCTL_GET_STATS, &stats);
+    printf("mount\n");
+    printf("  time                   %u us of device time\n", stats.mount_time_us);
+    printf("  records replayed       %u\n", stats.mount_records);
+    printf("  segments by summary    %u, by scan %u\n", stats.mount_summaries, stats.mount_scans);
+    for (int i = 0; i < WEAR_STATIC_FILES; i++) {
+        snprintf(path, sizeof(path), "/static%d", i);
+        if (!check_file(ctx, path, i, WEAR_STATIC_SIZE)) {
+            fprintf(stderr, "flashfs_wear: %s does not read back after the mount\n", path);
+            failed = 1;
+        }
+    }
+    ops.deinit(ctx);
+
+    return failed;
+}
@@ -10,18 +10,85 @@
  * @brief RamFS - Simple RAM-based File System
  * 
  * This is a simple example implementation of the DMFSI interface.
- * Files are stored entirely in RAM with a simple linked list structure.
+ * Files are stored entirely in RAM. They are found by a hash table of their
+ * names and listed through an index sorted by name.
+ *
+ * Optionally the file data can be tiered: when a memory budget and a
+ * backing DMFSI implementation are given in the config string, the least
+ * recently used files are moved to the backing file system when the budget
+ * is exceeded, and are loaded back on the next access:
+ *
+ *      budget=64k;backing=flashfs;backing_config=<config of flashfs>
+ *
+ * backing_config must be the last option, it takes the rest of the string.
  */
 
-#define RAMFS_MAX_FILENAME  64
 #define RAMFS_MAX_FILES     32
+#define RAMFS_INLINE_SIZE   32          // Files up to this size are stored in the node
+#define RAMFS_SPARSE_BLOCK  1024        // Block size of sparse files, also the smallest hole
 #define RAMFS_CONTEXT_MAGIC 0x52414D46  // "RAMF" in hex
 
+// Log every open/close/read/write/seek/stat/unlink/rename - set to 0 for tight loops and scans
+#ifndef RAMFS_LOG_IO
+#   define RAMFS_LOG_IO     1
+#endif
+
+#if RAMFS_LOG_IO
+#   define RAMFS_IO_LOG(...)    Dmod_Printf(__VA_ARGS__)
+#else
+#   define RAMFS_IO_LOG(...)    ((void)0)
+#endif
+
+// Atomic operations used by concurrent writers
+#define RAMFS_ATOMIC_LOAD(p)            __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RAMFS_ATOMIC_FETCH_ADD(p, v)    __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#define RAMFS_ATOMIC_FETCH_SUB(p, v)    __atomic_fetch_sub((p), (v), __ATOMIC_ACQ_REL)
+#define RAMFS_ATOMIC_FETCH_OR(p, v)     __atomic_fetch_or((p), (v), __ATOMIC_ACQ_REL)
+#define RAMFS_ATOMIC_FETCH_AND(p, v)    __atomic_fetch_and((p), (v), __ATOMIC_ACQ_REL)
+#define RAMFS_ATOMIC_CAS(p, e, v)       __atomic_compare_exchange_n((p), (e), (v), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+// Called while waiting for writers to finish their copies - e.g. a yield on a preemptive single core
+#ifndef RAMFS_SPIN_WAIT
+#   define RAMFS_SPIN_WAIT()    ((void)0)
+#endif
+
+#define RAMFS_GATE_CLOSED   0x80000000u // Buffers are being moved, writers take the lock
+
+// Context check of operations on an opened handle (see DMFSI_VALIDATE_HOT_PATH)
+#if DMFSI_VALIDATE_HOT_PATH
+#   define RAMFS_HOT_PATH_CTX_IS_VALID(ctx)  ((ctx) != NULL && (ctx)->magic == RAMFS_CONTEXT_MAGIC)
+#else
+#   define RAMFS_HOT_PATH_CTX_IS_VALID(ctx)  1
+#endif
+
+// Tiering state of a file
+#define RAMFS_TIER_EVICTED  0x01    // Data is only in the backing file system
+#define RAMFS_TIER_STORED   0x02    // Backing file system has a copy of the data
+#define RAMFS_TIER_DIRTY    0x04    // Data changed since it was stored
+
+struct ramfs_file_s;
+struct ramfs_watch_s;
+
 // Context structure definition
 struct dmfsi_context {
     uint32_t magic;          // Magic number for validation
-    void* file_list;         // Pointer to file list
     int initialized;         // Initialization flag
+    size_t mem_budget;       // RAM budget for file data (0 - unlimited)
+    size_t mem_used;         // RAM currently used by file data
+    dmfsi_ops_t backing;     // Operations of the backing file system
+    dmfsi_context_t backing_ctx;        // Backing file system (NULL - tiering disabled)
+    struct ramfs_file_s* lru_head;      // Most recently used file
+    struct ramfs_file_s* lru_tail;      // Least recently used file
+    uint32_t next_backing_id;           // Id for the next file stored in the backing FS
+    struct ramfs_watch_s* watches;      // Active change watches
+    uint32_t next_cookie;               // Cookie for the next rename
+    void* write_lock;                   // Serializes writes that move or allocate data
+    uint32_t write_gate;                // Readers, lookups and writers without the lock, RAMFS_GATE_CLOSED
+    struct ramfs_file_s** index;        // All files sorted by name, directories are ranges of it
+    uint32_t index_count;
+    uint32_t index_capacity;
+    struct ramfs_file_s** table;        // Files by the hash of the name, chained
+    uint32_t table_size;                // Number of buckets, a power of 2
 };
 
 // Helper functions to replace stdlib functions
@@ -46,6 +113,15 @@ static char* ramfs_strncpy(char* dest, const char* src, size_t n)
     return dest;
 }
 
+static size_t ramfs_strlen(const char* s)
+{
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
 static void* ramfs_memcpy(void* dest, const void* src, size_t n)
 {
     unsigned char* d = (unsigned char*)dest;
@@ -56,16 +132,179 @@ static void* ramfs_memcpy(void* dest, const void* src, size_t n)
     return dest;
 }
 
+static void* ramfs_memset(void* dest, int c, size_t n)
+{
+    unsigned char* d = (unsigned char*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (unsigned char)c;
+    }
+    return dest;
+}
+
+// FNV-1a hash of a path, continued from the hash of the part before @p s
+static uint32_t ramfs_hash_from(uint32_t hash, const char* s)
+{
+    while (*s) {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a hash of a path, used to find the files by name
+static inline uint32_t ramfs_hash(const char* s)
+{
+    return ramfs_hash_from(2166136261u, s);
+}
+
+// Storage layout of a file node
+#define RAMFS_LAYOUT_INLINE     0x01    // Data is stored in the node itself
+#define RAMFS_LAYOUT_NAME_HEAP  0x02    // Name is in a separate allocation (after rename)
+#define RAMFS_LAYOUT_SPARSE     0x04    // Data is in blocks, missing blocks are holes
+
+/**
+ * File node - 64 bytes on 64-bit targets, so a lookup touches a single cache
+ * line per file. The name is allocated together with the node, directly
+ * after it. Small files keep their data in the node, larger ones in a
+ * separate buffer; only those take part in tiering. A file written after a
+ * seek of at least RAMFS_SPARSE_BLOCK past its end is switched to a table of
+ * blocks, where the blocks never written are not allocated.
+ */
 typedef struct ramfs_file_s {
-    char name[RAMFS_MAX_FILENAME];
-    uint8_t* data;
-    size_t size;
-    size_t capacity;
-    size_t position;
-    int flags;
-    struct ramfs_file_s* next;
+    struct ramfs_file_s* chain;         // Next file in the same bucket of the name table
+    char* name;
+    uint32_t hash;
+    uint32_t size;
+    uint32_t tail;                      // End of the space reserved by writers
+    uint16_t flags;
+    uint8_t tier;                       // RAMFS_TIER_* flags
+    uint8_t layout;                     // RAMFS_LAYOUT_* flags
+    union {
+        uint8_t inline_data[RAMFS_INLINE_SIZE];
+        struct {
+            uint8_t* data;
+            uint32_t capacity;
+            uint32_t backing_id;        // Name of the copy in the backing FS
+            struct ramfs_file_s* lru_prev;
+            struct ramfs_file_s* lru_next;
+        } heap;
+        struct {
+            uint8_t** blocks;           // RAMFS_SPARSE_BLOCK bytes each, NULL - hole
+            uint32_t block_count;       // Number of entries in blocks
+        } sparse;
+    };
 } ramfs_file_t;
 
+// Opened file, every handle has its own position
+typedef struct {
+    ramfs_file_t* file;
+    uint32_t position;
+    int mode;
+} ramfs_handle_t;
+
+// Opened directory, lists the run of the index starting with the key
+typedef struct {
+    uint32_t position;                  // Next entry of the index
+    size_t dir_length;                  // Length of the directory path with its '/'
+    size_t key_length;
+    uint32_t hash;                      // Hash of the directory path with its '/'
+    int filtered;
+    dmfsi_dir_filter_t filter;
+    char key[];                         // Directory path, '/' and the prefix of the filter
+} ramfs_dir_t;
+
+// Helper function to get the data of a file (NULL if it is evicted)
+static inline uint8_t* ramfs_file_data(ramfs_file_t* file)
+{
+    return (file->layout & RAMFS_LAYOUT_INLINE) ? file->inline_data : file->heap.data;
+}
+
+// Helper function to get the number of bytes the file can hold without reallocation
+static inline uint32_t ramfs_file_capacity(const ramfs_file_t* file)
+{
+    return (file->layout & RAMFS_LAYOUT_INLINE) ? RAMFS_INLINE_SIZE : file->heap.capacity;
+}
+
+// Helper function to get the block of a sparse file holding an offset (NULL in a hole)
+static inline uint8_t* ramfs_sparse_block(const ramfs_file_t* file, uint32_t offset)
+{
+    uint32_t index = offset / RAMFS_SPARSE_BLOCK;
+    return (index < file->sparse.block_count) ? file->sparse.blocks[index] : NULL;
+}
+
+/**
+ * Path of a file, given as the path of a directory (with its '/') and a
+ * name in it. Names relative to an opened directory are resolved without
+ * copying or hashing the directory part again.
+ */
+typedef struct {
+    const char* dir;
+    size_t dir_length;
+    const char* name;
+    uint32_t hash;                      // Hash of the whole path
+} ramfs_path_t;
+
+// Helper function to set up a full path
+static inline void ramfs_path_full(ramfs_path_t* path, const char* name)
+{
+    path->dir = "";
+    path->dir_length = 0;
+    path->name = name;
+    path->hash = ramfs_hash(name);
+}
+
+// Helper function to set up a path relative to an opened directory, names starting with '/' are full paths
+static int ramfs_path_at(ramfs_path_t* path, void* dp, const char* name)
+{
+    if (name == NULL || name[0] == '\0') {
+        return DMFSI_ERR_INVALID;
+    }
+    if (name[0] == '/') {
+        ramfs_path_full(path, name);
+        return DMFSI_OK;
+    }
+    
+    const ramfs_dir_t* dir = (const ramfs_dir_t*)dp;
+    if (dir == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    path->dir = dir->key;
+    path->dir_length = dir->dir_length;
+    path->name = name;
+    path->hash = ramfs_hash_from(dir->hash, name);
+    return DMFSI_OK;
+}
+
+// Helper function to check if a name starts with the first @p length characters of @p prefix
+static inline int ramfs_starts_with(const char* name, const char* prefix, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        if (name[i] != prefix[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Helper function to find a file in the name table
+static ramfs_file_t* ramfs_lookup(dmfsi_context_t ctx, const ramfs_path_t* path)
+{
+    if (ctx->table_size == 0) {
+        return NULL;
+    }
+    
+    ramfs_file_t* file = ctx->table[path->hash & (ctx->table_size - 1)];
+    while (file != NULL) {
+        if (file->hash == path->hash
+            && ramfs_starts_with(file->name, path->dir, path->dir_length)
+            && ramfs_strcmp(file->name + path->dir_length, path->name) == 0) {
+            return file;
+        }
+        file = file->chain;
+    }
+    return NULL;
+}
+
 // Helper function to find a file by name
 static ramfs_file_t* ramfs_find_file(dmfsi_context_t ctx, const char* path)
 {
@@ -73,16 +312,927 @@ static ramfs_file_t* ramfs_find_file(dmfsi_context_t ctx, const char* path)
         return NULL;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)ctx->file_list;
-    while (file != NULL) {
-        if (ramfs_strcmp(file->name, path) == 0) {
-            return file;
+    ramfs_path_t full;
+    ramfs_path_full(&full, path);
+    return ramfs_lookup(ctx, &full);
+}
+
+// Helper function to find the first file of the index whose name is not less than @p name
+static uint32_t ramfs_index_lower(dmfsi_context_t ctx, const char* name)
+{
+    uint32_t low = 0;
+    uint32_t high = ctx->index_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (ramfs_strcmp(ctx->index[middle]->name, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Helper function to find the end of the run of names starting with a prefix, from @p position in it
+static uint32_t ramfs_index_skip(dmfsi_context_t ctx, uint32_t position, const char* prefix, size_t length)
+{
+    uint32_t low = position;
+    uint32_t high = ctx->index_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (ramfs_starts_with(ctx->index[middle]->name, prefix, length)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Helper function to add a file to the index
+static int ramfs_index_insert(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (ctx->index_count == ctx->index_capacity) {
+        uint32_t capacity = ctx->index_capacity ? ctx->index_capacity * 2 : RAMFS_MAX_FILES;
+        ramfs_file_t** index = (ramfs_file_t**)Dmod_Malloc(capacity * sizeof(ramfs_file_t*));
+        if (index == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+        if (ctx->index != NULL) {
+            ramfs_memcpy(index, ctx->index, ctx->index_count * sizeof(ramfs_file_t*));
+            Dmod_Free(ctx->index);
+        }
+        ctx->index = index;
+        ctx->index_capacity = capacity;
+    }
+    
+    uint32_t position = ramfs_index_lower(ctx, file->name);
+    for (uint32_t i = ctx->index_count; i > position; i--) {
+        ctx->index[i] = ctx->index[i - 1];
+    }
+    ctx->index[position] = file;
+    ctx->index_count++;
+    return DMFSI_OK;
+}
+
+// Helper function to remove a file from the index
+static void ramfs_index_remove(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    uint32_t position = ramfs_index_lower(ctx, file->name);
+    if (position < ctx->index_count && ctx->index[position] == file) {
+        ctx->index_count--;
+        for (uint32_t i = position; i < ctx->index_count; i++) {
+            ctx->index[i] = ctx->index[i + 1];
+        }
+    }
+}
+
+// Helper function to add a file to its bucket of the name table
+static inline void ramfs_table_insert(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    ramfs_file_t** bucket = &ctx->table[file->hash & (ctx->table_size - 1)];
+    file->chain = *bucket;
+    *bucket = file;
+}
+
+// Helper function to remove a file from the name table
+static void ramfs_table_remove(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    ramfs_file_t** link = &ctx->table[file->hash & (ctx->table_size - 1)];
+    while (*link != NULL) {
+        if (*link == file) {
+            *link = file->chain;
+            return;
+        }
+        link = &(*link)->chain;
+    }
+}
+
+// Helper function to double the number of buckets of the name table
+static int ramfs_table_grow(dmfsi_context_t ctx)
+{
+    uint32_t size = ctx->table_size ? ctx->table_size * 2 : RAMFS_MAX_FILES;
+    ramfs_file_t** table = (ramfs_file_t**)Dmod_Malloc(size * sizeof(ramfs_file_t*));
+    if (table == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    ramfs_memset(table, 0, size * sizeof(ramfs_file_t*));
+    
+    ramfs_file_t** old = ctx->table;
+    uint32_t old_size = ctx->table_size;
+    ctx->table = table;
+    ctx->table_size = size;
+    for (uint32_t i = 0; i < old_size; i++) {
+        ramfs_file_t* file = old[i];
+        while (file != NULL) {
+            ramfs_file_t* chain = file->chain;
+            ramfs_table_insert(ctx, file);
+            file = chain;
+        }
+    }
+    if (old != NULL) {
+        Dmod_Free(old);
+    }
+    return DMFSI_OK;
+}
+
+// Helper function to add a new file to the index and the name table
+static int ramfs_file_link(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (ramfs_index_insert(ctx, file) != DMFSI_OK) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    // Longer chains are still correct, only a missing table is an error
+    if (ctx->index_count > ctx->table_size && ramfs_table_grow(ctx) != DMFSI_OK && ctx->table_size == 0) {
+        ramfs_index_remove(ctx, file);
+        return DMFSI_ERR_NO_SPACE;
+    }
+    ramfs_table_insert(ctx, file);
+    return DMFSI_OK;
+}
+
+// Helper function to take a file out of the index and the name table
+static void ramfs_file_unlink(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    ramfs_index_remove(ctx, file);
+    ramfs_table_remove(ctx, file);
+}
+
+// Helper function to fill the statistics of a file
+static void ramfs_fill_stat(ramfs_file_t* file, dmfsi_stat_t* stat)
+{
+    stat->size = RAMFS_ATOMIC_LOAD(&file->size);
+    stat->attr = 0;
+    stat->ctime = 0;
+    stat->mtime = 0;
+    stat->atime = 0;
+}
+
+// Helper function to find the value of an option in the config string
+static const char* ramfs_config_find(const char* config, const char* key)
+{
+    const char* p = config;
+    while (p != NULL && *p) {
+        const char* k = key;
+        const char* v = p;
+        while (*k && *v == *k) {
+            k++;
+            v++;
+        }
+        if (*k == '\0' && *v == '=') {
+            return v + 1;
+        }
+        while (*p && *p != ';') {
+            p++;
+        }
+        if (*p == ';') {
+            p++;
         }
-        file = file->next;
     }
     return NULL;
 }
 
+// Helper function to parse a size option with an optional k/m suffix
+static size_t ramfs_config_size(const char* config, const char* key)
+{
+    const char* v = ramfs_config_find(config, key);
+    size_t value = 0;
+    while (v != NULL && *v >= '0' && *v <= '9') {
+        value = value * 10 + (size_t)(*v - '0');
+        v++;
+    }
+    if (v != NULL && (*v == 'k' || *v == 'K')) {
+        value *= 1024;
+    } else if (v != NULL && (*v == 'm' || *v == 'M')) {
+        value *= 1024 * 1024;
+    }
+    return value;
+}
+
+// Helper function to copy a string option to a buffer
+static int ramfs_config_string(const char* config, const char* key, char* buffer, size_t size)
+{
+    const char* v = ramfs_config_find(config, key);
+    if (v == NULL) {
+        return 0;
+    }
+    size_t i = 0;
+    while (v[i] && v[i] != ';' && i < size - 1) {
+        buffer[i] = v[i];
+        i++;
+    }
+    buffer[i] = '\0';
+    return 1;
+}
+
+// Helper function to build the name of the copy of a file in the backing FS
+static void ramfs_backing_name(const ramfs_file_t* file, char* name)
+{
+    static const char digits[] = "0123456789abcdef";
+    ramfs_strncpy(name, "/ramfs_", 8);
+    for (int i = 0; i < 8; i++) {
+        name[7 + i] = digits[(file->heap.backing_id >> (28 - 4 * i)) & 0xF];
+    }
+    name[15] = '\0';
+}
+
+// Helper functions to maintain the LRU list used for tiering
+static void ramfs_lru_remove(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (file->layout & (RAMFS_LAYOUT_INLINE | RAMFS_LAYOUT_SPARSE)) {
+        return;
+    }
+    if (file->heap.lru_prev != NULL) {
+        file->heap.lru_prev->heap.lru_next = file->heap.lru_next;
+    } else if (ctx->lru_head == file) {
+        ctx->lru_head = file->heap.lru_next;
+    }
+    if (file->heap.lru_next != NULL) {
+        file->heap.lru_next->heap.lru_prev = file->heap.lru_prev;
+    } else if (ctx->lru_tail == file) {
+        ctx->lru_tail = file->heap.lru_prev;
+    }
+    file->heap.lru_prev = NULL;
+    file->heap.lru_next = NULL;
+}
+
+static void ramfs_lru_touch(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (ctx->backing_ctx == NULL || (file->layout & (RAMFS_LAYOUT_INLINE | RAMFS_LAYOUT_SPARSE)) || ctx->lru_head == file) {
+        return;
+    }
+    ramfs_lru_remove(ctx, file);
+    file->heap.lru_next = ctx->lru_head;
+    if (ctx->lru_head != NULL) {
+        ctx->lru_head->heap.lru_prev = file;
+    }
+    ctx->lru_head = file;
+    if (ctx->lru_tail == NULL) {
+        ctx->lru_tail = file;
+    }
+}
+
+// Helper function to move the data of a file to the backing FS
+static int ramfs_evict(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (!(file->tier & RAMFS_TIER_STORED) || (file->tier & RAMFS_TIER_DIRTY)) {
+        char name[16];
+        void* fp = NULL;
+        size_t written = 0;
+        
+        if (!(file->tier & RAMFS_TIER_STORED)) {
+            file->heap.backing_id = ctx->next_backing_id++;
+        }
+        ramfs_backing_name(file, name);
+        
+        int result = ctx->backing.fopen(ctx->backing_ctx, &fp, name,
+                                        DMFSI_O_WRONLY | DMFSI_O_CREAT | DMFSI_O_TRUNC, 0);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+        result = ctx->backing.fwrite(ctx->backing_ctx, fp, file->heap.data, file->size, &written);
+        ctx->backing.fclose(ctx->backing_ctx, fp);
+        if (result != DMFSI_OK || written != file->size) {
+            return (result != DMFSI_OK) ? result : DMFSI_ERR_NO_SPACE;
+        }
+        file->tier |= RAMFS_TIER_STORED;
+        file->tier &= ~RAMFS_TIER_DIRTY;
+    }
+    
+    Dmod_Free(file->heap.data);
+    ctx->mem_used -= file->heap.capacity;
+    file->heap.data = NULL;
+    file->heap.capacity = 0;
+    file->tier |= RAMFS_TIER_EVICTED;
+    return DMFSI_OK;
+}
+
+// Helper function to evict cold files until `size` more bytes fit in the budget
+static void ramfs_make_room(dmfsi_context_t ctx, size_t size, ramfs_file_t* keep)
+{
+    if (ctx->backing_ctx == NULL) {
+        return;
+    }
+    
+    ramfs_file_t* file = ctx->lru_tail;
+    while (file != NULL && ctx->mem_used + size > ctx->mem_budget) {
+        ramfs_file_t* prev = file->heap.lru_prev;
+        if (file != keep && file->heap.data != NULL) {
+            if (ramfs_evict(ctx, file) != DMFSI_OK) {
+                // The backing FS is full - keep the rest in RAM over budget
+                Dmod_Printf("RamFS: Failed to evict '%s'\n", file->name);
+                return;
+            }
+        }
+        file = prev;
+    }
+}
+
+// Helper function to allocate data buffer accounted in the memory budget
+static uint8_t* ramfs_data_alloc(dmfsi_context_t ctx, size_t capacity, ramfs_file_t* keep)
+{
+    ramfs_make_room(ctx, capacity, keep);
+    uint8_t* data = (uint8_t*)Dmod_Malloc(capacity);
+    if (data != NULL) {
+        ctx->mem_used += capacity;
+    }
+    return data;
+}
+
+// Helper function to load the data of an evicted file back to RAM
+static int ramfs_fault_in(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    ramfs_lru_touch(ctx, file);
+    if (!(file->tier & RAMFS_TIER_EVICTED)) {
+        return DMFSI_OK;
+    }
+    
+    uint32_t capacity = (file->size > 0) ? file->size : 1;
+    uint8_t* data = ramfs_data_alloc(ctx, capacity, file);
+    if (data == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    
+    char name[16];
+    void* fp = NULL;
+    size_t read = 0;
+    ramfs_backing_name(file, name);
+    int result = ctx->backing.fopen(ctx->backing_ctx, &fp, name, DMFSI_O_RDONLY, 0);
+    if (result == DMFSI_OK) {
+        result = ctx->backing.fread(ctx->backing_ctx, fp, data, file->size, &read);
+        ctx->backing.fclose(ctx->backing_ctx, fp);
+    }
+    if (result != DMFSI_OK || read != file->size) {
+        Dmod_Free(data);
+        ctx->mem_used -= capacity;
+        return (result != DMFSI_OK) ? result : DMFSI_ERR_GENERAL;
+    }
+    
+    file->heap.data = data;
+    file->heap.capacity = capacity;
+    file->tier &= ~RAMFS_TIER_EVICTED;
+    return DMFSI_OK;
+}
+
+// Helper function to release the data of a file and its copy in the backing FS
+static void ramfs_data_release(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    if (file->layout & RAMFS_LAYOUT_INLINE) {
+        return;
+    }
+    if (file->layout & RAMFS_LAYOUT_SPARSE) {
+        for (uint32_t i = 0; i < file->sparse.block_count; i++) {
+            if (file->sparse.blocks[i] != NULL) {
+                Dmod_Free(file->sparse.blocks[i]);
+                ctx->mem_used -= RAMFS_SPARSE_BLOCK;
+            }
+        }
+        if (file->sparse.blocks != NULL) {
+            Dmod_Free(file->sparse.blocks);
+        }
+        file->layout = (file->layout & ~RAMFS_LAYOUT_SPARSE) | RAMFS_LAYOUT_INLINE;
+        ramfs_memset(file->inline_data, 0, RAMFS_INLINE_SIZE);
+        return;
+    }
+    if (file->heap.data != NULL) {
+        Dmod_Free(file->heap.data);
+        ctx->mem_used -= file->heap.capacity;
+        file->heap.data = NULL;
+        file->heap.capacity = 0;
+    }
+    if (file->tier & RAMFS_TIER_STORED) {
+        char name[16];
+        ramfs_backing_name(file, name);
+        if (ctx->backing.unlink != NULL) {
+            ctx->backing.unlink(ctx->backing_ctx, name);
+        }
+    }
+    file->tier = 0;
+}
+
+// Helper function to free a file node that is no longer in the index
+static void ramfs_file_free(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    ramfs_lru_remove(ctx, file);
+    ramfs_data_release(ctx, file);
+    if (file->layout & RAMFS_LAYOUT_NAME_HEAP) {
+        Dmod_Free(file->name);
+    }
+    Dmod_Free(file);
+}
+
+// Helper function to get the length of a tree root without the trailing '/', 0 for the root
+static size_t ramfs_tree_length(const char* path)
+{
+    size_t length = ramfs_strlen(path);
+    while (length > 0 && path[length - 1] == '/') {
+        length--;
+    }
+    return length;
+}
+
+// Helper function to check if a name sorts before the names below a tree root (@p length excludes a trailing '/')
+static int ramfs_tree_before(const char* name, const char* path, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        if (name[i] != path[i]) {
+            return (unsigned char)name[i] < (unsigned char)path[i];
+        }
+    }
+    return (unsigned char)name[length] < '/';
+}
+
+// Helper function to find the files below a tree root, they are the range [*first, returned value) of the index
+static uint32_t ramfs_tree_range(dmfsi_context_t ctx, const char* path, size_t length, uint32_t* first)
+{
+    uint32_t low = 0;
+    uint32_t high = ctx->index_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (ramfs_tree_before(ctx->index[middle]->name, path, length)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    *first = low;
+    if (low == ctx->index_count || !ramfs_starts_with(ctx->index[low]->name, path, length)
+        || ctx->index[low]->name[length] != '/') {
+        return low;
+    }
+    return ramfs_index_skip(ctx, low, ctx->index[low]->name, length + 1);
+}
+
+// Helper function to get the length of the common beginning of two names, 0 without @p previous
+static size_t ramfs_common_length(const char* name, const char* previous)
+{
+    size_t length = 0;
+    if (previous != NULL) {
+        while (name[length] != '\0' && name[length] == previous[length]) {
+            length++;
+        }
+    }
+    return length;
+}
+
+/**
+ * RamFS has no directories, they are the paths of the files. The files of
+ * a directory are next to each other in the index, so a directory of a
+ * file below a tree root is new when the previous file of the range is not
+ * in it, i.e. the names have less than the directory path in common.
+ */
+static int ramfs_tree_dirs(const char* name, const char* previous, size_t length)
+{
+    size_t common = ramfs_common_length(name, previous);
+    int count = 0;
+    for (size_t i = length + 1; name[i] != '\0'; i++) {
+        if (name[i] == '/' && i >= common) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Helper function to report the new directories of a file (see ramfs_tree_dirs), the copy of its name is cut at each of them
+static int ramfs_walk_dirs(char* name, const char* previous, size_t length, dmfsi_walk_fn_t callback, void* arg)
+{
+    dmfsi_stat_t stat;
+    stat.size = 0;
+    stat.attr = DMFSI_ATTR_DIRECTORY;
+    stat.ctime = 0;
+    stat.mtime = 0;
+    stat.atime = 0;
+    
+    size_t common = ramfs_common_length(name, previous);
+    int result = DMFSI_OK;
+    for (size_t i = length + 1; result == DMFSI_OK && name[i] != '\0'; i++) {
+        if (name[i] == '/' && i >= common) {
+            name[i] = '\0';
+            result = callback(arg, name, &stat);
+            name[i] = '/';
+        }
+    }
+    return result;
+}
+
+// Helper function to copy a name for a callback, the buffer grows when needed
+static int ramfs_name_copy(char** buffer, size_t* capacity, const char* name)
+{
+    size_t size = ramfs_strlen(name) + 1;
+    if (size > *capacity) {
+        char* copy = (char*)Dmod_Malloc(size);
+        if (copy == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+        if (*buffer != NULL) {
+            Dmod_Free(*buffer);
+        }
+        *buffer = copy;
+        *capacity = size;
+    }
+    ramfs_memcpy(*buffer, name, size);
+    return DMFSI_OK;
+}
+
+// Helper function to read from a sparse file, holes read as zeros
+static void ramfs_sparse_read(const ramfs_file_t* file, uint32_t offset, uint8_t* buffer, size_t size)
+{
+    while (size > 0) {
+        uint32_t in_block = offset % RAMFS_SPARSE_BLOCK;
+        size_t chunk = RAMFS_SPARSE_BLOCK - in_block;
+        if (chunk > size) {
+            chunk = size;
+        }
+        
+        const uint8_t* block = ramfs_sparse_block(file, offset);
+        if (block != NULL) {
+            ramfs_memcpy(buffer, block + in_block, chunk);
+        } else {
+            ramfs_memset(buffer, 0, chunk);
+        }
+        buffer += chunk;
+        offset += (uint32_t)chunk;
+        size -= chunk;
+    }
+}
+
+// Helper function to write to a sparse file, blocks are allocated when first written
+static int ramfs_sparse_write(dmfsi_context_t ctx, ramfs_file_t* file, uint32_t offset, const uint8_t* buffer, size_t size)
+{
+    uint32_t count = (uint32_t)(((size_t)offset + size + RAMFS_SPARSE_BLOCK - 1) / RAMFS_SPARSE_BLOCK);
+    if (count > file->sparse.block_count) {
+        uint32_t new_count = file->sparse.block_count * 2;
+        if (new_count < count) {
+            new_count = count;
+        }
+        uint8_t** blocks = (uint8_t**)Dmod_Malloc(new_count * sizeof(uint8_t*));
+        if (blocks == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+        for (uint32_t i = 0; i < new_count; i++) {
+            blocks[i] = (i < file->sparse.block_count) ? file->sparse.blocks[i] : NULL;
+        }
+        if (file->sparse.blocks != NULL) {
+            Dmod_Free(file->sparse.blocks);
+        }
+        file->sparse.blocks = blocks;
+        file->sparse.block_count = new_count;
+    }
+    
+    while (size > 0) {
+        uint32_t index = offset / RAMFS_SPARSE_BLOCK;
+        uint32_t in_block = offset % RAMFS_SPARSE_BLOCK;
+        size_t chunk = RAMFS_SPARSE_BLOCK - in_block;
+        if (chunk > size) {
+            chunk = size;
+        }
+        
+        if (file->sparse.blocks[index] == NULL) {
+            uint8_t* block = ramfs_data_alloc(ctx, RAMFS_SPARSE_BLOCK, file);
+            if (block == NULL) {
+                return DMFSI_ERR_NO_SPACE;
+            }
+            ramfs_memset(block, 0, RAMFS_SPARSE_BLOCK);
+            file->sparse.blocks[index] = block;
+        }
+        ramfs_memcpy(file->sparse.blocks[index] + in_block, buffer, chunk);
+        buffer += chunk;
+        offset += (uint32_t)chunk;
+        size -= chunk;
+    }
+    return DMFSI_OK;
+}
+
+// Helper function to check if a range holds only zeros
+static int ramfs_is_zero(const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Helper function to move the data of a file to sparse blocks, blocks of zeros become holes
+static int ramfs_make_sparse(dmfsi_context_t ctx, ramfs_file_t* file)
+{
+    uint32_t count = (file->size + RAMFS_SPARSE_BLOCK - 1) / RAMFS_SPARSE_BLOCK;
+    uint8_t** blocks = NULL;
+    if (count > 0) {
+        blocks = (uint8_t**)Dmod_Malloc(count * sizeof(uint8_t*));
+        if (blocks == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+    }
+    
+    const uint8_t* data = ramfs_file_data(file);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = i * RAMFS_SPARSE_BLOCK;
+        uint32_t length = file->size - offset;
+        if (length > RAMFS_SPARSE_BLOCK) {
+            length = RAMFS_SPARSE_BLOCK;
+        }
+        
+        blocks[i] = NULL;
+        if (ramfs_is_zero(data + offset, length)) {
+            continue;
+        }
+        blocks[i] = ramfs_data_alloc(ctx, RAMFS_SPARSE_BLOCK, file);
+        if (blocks[i] == NULL) {
+            for (uint32_t j = 0; j < i; j++) {
+                if (blocks[j] != NULL) {
+                    Dmod_Free(blocks[j]);
+                    ctx->mem_used -= RAMFS_SPARSE_BLOCK;
+                }
+            }
+            Dmod_Free(blocks);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        ramfs_memcpy(blocks[i], data + offset, length);
+        ramfs_memset(blocks[i] + length, 0, RAMFS_SPARSE_BLOCK - length);
+    }
+    
+    // Sparse files stay in RAM, so the file leaves the tiering
+    if (!(file->layout & RAMFS_LAYOUT_INLINE)) {
+        ramfs_lru_remove(ctx, file);
+        ramfs_data_release(ctx, file);
+    }
+    file->layout = (file->layout & ~RAMFS_LAYOUT_INLINE) | RAMFS_LAYOUT_SPARSE;
+    file->sparse.blocks = blocks;
+    file->sparse.block_count = count;
+    return DMFSI_OK;
+}
+
+// Helper function to find the first data (or hole) at or after an offset inside the file
+static long ramfs_seek_extent(const ramfs_file_t* file, uint32_t offset, int data)
+{
+    if (!(file->layout & RAMFS_LAYOUT_SPARSE)) {
+        return data ? (long)offset : (long)file->size;
+    }
+    
+    uint32_t count = (file->size + RAMFS_SPARSE_BLOCK - 1) / RAMFS_SPARSE_BLOCK;
+    for (uint32_t i = offset / RAMFS_SPARSE_BLOCK; i < count; i++) {
+        int has_data = (i < file->sparse.block_count && file->sparse.blocks[i] != NULL);
+        if (has_data == data) {
+            uint32_t start = i * RAMFS_SPARSE_BLOCK;
+            return (start > offset) ? (long)start : (long)offset;
+        }
+    }
+    return data ? DMFSI_ERR_NOT_FOUND : (long)file->size;
+}
+
+// Helper functions for the write lock, it is optional on targets without threads
+static inline void ramfs_lock(dmfsi_context_t ctx)
+{
+    if (ctx->write_lock != NULL) {
+        Dmod_Mutex_Lock(ctx->write_lock);
+    }
+}
+
+static inline void ramfs_unlock(dmfsi_context_t ctx)
+{
+    if (ctx->write_lock != NULL) {
+        Dmod_Mutex_Unlock(ctx->write_lock);
+    }
+}
+
+/**
+ * Readers and the writers that fit in the current buffer copy without the
+ * lock, they only pass the gate. A writer that has to move or allocate data
+ * takes the lock, closes the gate and waits until the copies in progress
+ * are finished. The index, the name table and the names of the files are
+ * changed the same way, so lookups pass the gate too.
+ */
+static inline int ramfs_gate_enter(dmfsi_context_t ctx)
+{
+    if (RAMFS_ATOMIC_FETCH_ADD(&ctx->write_gate, 1) & RAMFS_GATE_CLOSED) {
+        RAMFS_ATOMIC_FETCH_SUB(&ctx->write_gate, 1);
+        return 0;
+    }
+    return 1;
+}
+
+static inline void ramfs_gate_leave(dmfsi_context_t ctx)
+{
+    RAMFS_ATOMIC_FETCH_SUB(&ctx->write_gate, 1);
+}
+
+static void ramfs_gate_close(dmfsi_context_t ctx)
+{
+    RAMFS_ATOMIC_FETCH_OR(&ctx->write_gate, RAMFS_GATE_CLOSED);
+    while ((RAMFS_ATOMIC_LOAD(&ctx->write_gate) & ~RAMFS_GATE_CLOSED) != 0) {
+        RAMFS_SPIN_WAIT();
+    }
+}
+
+static inline void ramfs_gate_open(dmfsi_context_t ctx)
+{
+    RAMFS_ATOMIC_FETCH_AND(&ctx->write_gate, ~RAMFS_GATE_CLOSED);
+}
+
+// Helper functions for lookups in the index and the name table, they pass the gate or wait for the lock
+static inline int ramfs_lookup_enter(dmfsi_context_t ctx)
+{
+    if (ramfs_gate_enter(ctx)) {
+        return 1;
+    }
+    ramfs_lock(ctx);
+    return 0;
+}
+
+static inline void ramfs_lookup_leave(dmfsi_context_t ctx, int gated)
+{
+    if (gated) {
+        ramfs_gate_leave(ctx);
+    } else {
+        ramfs_unlock(ctx);
+    }
+}
+
+// Helper function to raise a value that is updated by several writers
+static inline void ramfs_atomic_max(uint32_t* value, uint32_t new_value)
+{
+    uint32_t current = RAMFS_ATOMIC_LOAD(value);
+    while (current < new_value && !RAMFS_ATOMIC_CAS(value, &current, new_value)) {
+    }
+}
+
+/**
+ * Helper function to write with the lock held and the gate closed
+ *
+ * The bytes between the size and the capacity of a dense file are kept
+ * zeroed, so a write after the end (or an append whose neighbours are not
+ * copied yet) never exposes old data.
+ */
+static int ramfs_write_locked(dmfsi_context_t ctx, ramfs_file_t* file, uint32_t offset, const void* buffer, size_t size, int append)
+{
+    if (ctx->backing_ctx != NULL) {
+        int result = ramfs_fault_in(ctx, file);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    }
+    
+    // A large gap after the end becomes a hole instead of zeroed memory
+    size_t needed = (size_t)offset + size;
+    if (!append && !(file->layout & RAMFS_LAYOUT_SPARSE) && offset > file->size
+        && offset - file->size >= RAMFS_SPARSE_BLOCK) {
+        int result = ramfs_make_sparse(ctx, file);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    }
+    
+    if (file->layout & RAMFS_LAYOUT_SPARSE) {
+        int result = ramfs_sparse_write(ctx, file, offset, (const uint8_t*)buffer, size);
+        if (result != DMFSI_OK) {
+            return result;
+        }
+    } else {
+        // Check if we need to expand the buffer
+        if (needed > ramfs_file_capacity(file)) {
+            size_t new_capacity = needed * 2; // Double the capacity
+            if (new_capacity < 256) {
+                new_capacity = 256;
+            }
+            if (new_capacity > UINT32_MAX) {
+                new_capacity = UINT32_MAX;
+            }
+            
+            uint8_t* new_data = ramfs_data_alloc(ctx, new_capacity, file);
+            if (new_data == NULL) {
+                return DMFSI_ERR_NO_SPACE;
+            }
+            
+            if (file->layout & RAMFS_LAYOUT_INLINE) {
+                // Move the data out of the node, this frees the space for the heap fields
+                ramfs_memcpy(new_data, file->inline_data, file->size);
+                file->layout &= ~RAMFS_LAYOUT_INLINE;
+                file->heap.lru_prev = NULL;
+                file->heap.lru_next = NULL;
+                file->heap.backing_id = 0;
+            } else if (file->heap.data != NULL) {
+                ramfs_memcpy(new_data, file->heap.data, file->size);
+                Dmod_Free(file->heap.data);
+                ctx->mem_used -= file->heap.capacity;
+            }
+            ramfs_memset(new_data + file->size, 0, new_capacity - file->size);
+            
+            file->heap.data = new_data;
+            file->heap.capacity = (uint32_t)new_capacity;
+            ramfs_lru_touch(ctx, file);
+        }
+        
+        ramfs_memcpy(ramfs_file_data(file) + offset, buffer, size);
+    }
+    file->tier |= RAMFS_TIER_DIRTY;
+    ramfs_atomic_max(&file->size, (uint32_t)needed);
+    ramfs_atomic_max(&file->tail, (uint32_t)needed);
+    return DMFSI_OK;
+}
+
+// Change watch, events are queued when files are changed
+typedef struct ramfs_watch_s {
+    struct ramfs_watch_s* next;
+    uint32_t mask;
+    size_t path_length;
+    char path[256];
+    dmfsi_event_t* queue;
+    size_t queue_length;
+    size_t head;
+    size_t count;
+    int overflow;
+} ramfs_watch_t;
+
+// Helper function to copy the data at a position, with the gate passed or the lock held
+static size_t ramfs_read_at(ramfs_file_t* file, uint32_t position, void* buffer, size_t size)
+{
+    uint32_t file_size = RAMFS_ATOMIC_LOAD(&file->size);
+    size_t available = (position < file_size) ? file_size - position : 0;
+    size_t to_read = (size < available) ? size : available;
+    
+    if (to_read > 0) {
+        if (file->layout & RAMFS_LAYOUT_SPARSE) {
+            ramfs_sparse_read(file, position, (uint8_t*)buffer, to_read);
+        } else {
+            ramfs_memcpy(buffer, ramfs_file_data(file) + position, to_read);
+        }
+    }
+    return to_read;
+}
+
+// Helper function to read a file, the buffer may be moved by a writer in the meantime
+static int ramfs_read(dmfsi_context_t ctx, ramfs_file_t* file, uint32_t position, void* buffer, size_t size, size_t* read)
+{
+    if (ctx->backing_ctx == NULL && ramfs_gate_enter(ctx)) {
+        *read = ramfs_read_at(file, position, buffer, size);
+        ramfs_gate_leave(ctx);
+        return DMFSI_OK;
+    }
+    
+    // Tiering may evict the data of any file when another one grows, so the copy is done with the lock
+    ramfs_lock(ctx);
+    int result = (ctx->backing_ctx != NULL) ? ramfs_fault_in(ctx, file) : DMFSI_OK;
+    *read = (result == DMFSI_OK) ? ramfs_read_at(file, position, buffer, size) : 0;
+    ramfs_unlock(ctx);
+    return result;
+}
+
+// Helper function to check if a watch covers a path (the path itself or a file below it)
+static int ramfs_watch_matches(const ramfs_watch_t* watch, const char* path)
+{
+    size_t i = 0;
+    while (i < watch->path_length && path[i] == watch->path[i]) {
+        i++;
+    }
+    if (i < watch->path_length) {
+        return 0;
+    }
+    return path[i] == '\0' || path[i] == '/' || watch->path[i - 1] == '/';
+}
+
+// Helper function to check if a change of a file is queued by any watch, with the gate passed or the lock held
+static int ramfs_watched(dmfsi_context_t ctx, const char* path)
+{
+    for (const ramfs_watch_t* watch = ctx->watches; watch != NULL; watch = watch->next) {
+        if ((watch->mask & DMFSI_EVENT_MODIFY) && ramfs_watch_matches(watch, path)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Helper function to queue an event in every watch that covers the path
+static void ramfs_notify(dmfsi_context_t ctx, uint32_t type, const char* path, uint32_t cookie)
+{
+    for (ramfs_watch_t* watch = ctx->watches; watch != NULL; watch = watch->next) {
+        if ((watch->mask & type) == 0 || !ramfs_watch_matches(watch, path)) {
+            continue;
+        }
+        
+        // Writes in a row are reported once
+        if (type == DMFSI_EVENT_MODIFY && watch->count > 0) {
+            const dmfsi_event_t* last = &watch->queue[(watch->head + watch->count - 1) % watch->queue_length];
+            if (last->type == DMFSI_EVENT_MODIFY && ramfs_strcmp(last->path, path) == 0) {
+                continue;
+            }
+        }
+        if (watch->count == watch->queue_length) {
+            watch->overflow = 1;
+            continue;
+        }
+        
+        dmfsi_event_t* event = &watch->queue[(watch->head + watch->count) % watch->queue_length];
+        event->type = type;
+        event->cookie = cookie;
+        ramfs_strncpy(event->path, path, sizeof(event->path) - 1);
+        event->path[sizeof(event->path) - 1] = '\0';
+        watch->count++;
+    }
+}
+
 // Implement _init for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, dmfsi_context_t, _init, (const char* config) )
 {
@@ -96,8 +1246,44 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, dmfsi_context_t, _init, (const char*
     }
     
     ctx->magic = RAMFS_CONTEXT_MAGIC;
-    ctx->file_list = NULL;
     ctx->initialized = 1;
+    ctx->mem_budget = ramfs_config_size(config, "budget");
+    ctx->mem_used = 0;
+    ctx->backing_ctx = NULL;
+    ctx->lru_head = NULL;
+    ctx->lru_tail = NULL;
+    ctx->next_backing_id = 0;
+    ctx->watches = NULL;
+    ctx->next_cookie = 0;
+    ctx->write_lock = Dmod_Mutex_New(false);
+    ctx->write_gate = 0;
+    ctx->index = NULL;
+    ctx->index_count = 0;
+    ctx->index_capacity = 0;
+    ctx->table = NULL;
+    ctx->table_size = 0;
+    
+    char backing_name[32];
+    if (ctx->mem_budget > 0 && ramfs_config_string(config, "backing", backing_name, sizeof(backing_name))) {
+        if (dmfsi_ops_resolve_by_name(backing_name, &ctx->backing) != DMFSI_OK) {
+            Dmod_Printf("RamFS: Backing file system '%s' not available\n", backing_name);
+            if (ctx->write_lock != NULL) {
+                Dmod_Mutex_Delete(ctx->write_lock);
+            }
+            Dmod_Free(ctx);
+            return NULL;
+        }
+        ctx->backing_ctx = ctx->backing.init(ramfs_config_find(config, "backing_config"));
+        if (ctx->backing_ctx == NULL) {
+            Dmod_Printf("RamFS: Failed to initialize backing file system '%s'\n", backing_name);
+            if (ctx->write_lock != NULL) {
+                Dmod_Mutex_Delete(ctx->write_lock);
+            }
+            Dmod_Free(ctx);
+            return NULL;
+        }
+        Dmod_Printf("RamFS: Tiering to '%s' with budget %zu bytes\n", backing_name, ctx->mem_budget);
+    }
     
     Dmod_Printf("RamFS: Initialized successfully\n");
     return ctx;
@@ -113,14 +1299,36 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _deinit, (dmfsi_context_t ctx)
     }
     
     // Free all files
-    ramfs_file_t* file = (ramfs_file_t*)ctx->file_list;
-    while (file != NULL) {
-        ramfs_file_t* next = file->next;
-        if (file->data != NULL) {
-            Dmod_Free(file->data);
+    for (uint32_t i = 0; i < ctx->index_count; i++) {
+        ramfs_file_t* file = ctx->index[i];
+        ramfs_data_release(ctx, file);
+        if (file->layout & RAMFS_LAYOUT_NAME_HEAP) {
+            Dmod_Free(file->name);
         }
         Dmod_Free(file);
-        file = next;
+    }
+    if (ctx->index != NULL) {
+        Dmod_Free(ctx->index);
+    }
+    if (ctx->table != NULL) {
+        Dmod_Free(ctx->table);
+    }
+    
+    // Free all watches
+    while (ctx->watches != NULL) {
+        ramfs_watch_t* watch = ctx->watches;
+        ctx->watches = watch->next;
+        Dmod_Free(watch->queue);
+        Dmod_Free(watch);
+    }
+    
+    if (ctx->backing_ctx != NULL) {
+        ctx->backing.deinit(ctx->backing_ctx);
+        ctx->backing_ctx = NULL;
+    }
+    if (ctx->write_lock != NULL) {
+        Dmod_Mutex_Delete(ctx->write_lock);
+        ctx->write_lock = NULL;
     }
     
     // Clear magic to detect use-after-free and free context
@@ -142,142 +1350,233 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _context_is_valid, (dmfsi_conte
     return 1;
 }
 
-// Implement _fopen for RamFS
-dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fopen, (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr) )
+// Helper function to open or create a file
+static int ramfs_open(dmfsi_context_t ctx, void** fp, const ramfs_path_t* path, int mode)
 {
-    Dmod_Printf("RamFS: Opening file '%s' with mode 0x%x\n", path, mode);
-    
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
-        return DMFSI_ERR_INVALID;
+    ramfs_handle_t* handle = (ramfs_handle_t*)Dmod_Malloc(sizeof(ramfs_handle_t));
+    if (handle == NULL) {
+        return DMFSI_ERR_NO_SPACE;
     }
     
-    ramfs_file_t* file = ramfs_find_file(ctx, path);
+    // Tasks may open the same file at once, e.g. a shared log
+    ramfs_lock(ctx);
+    ramfs_file_t* file = ramfs_lookup(ctx, path);
     
     // Check if file exists
     if (file != NULL) {
         // File exists
         if (mode & DMFSI_O_CREAT) {
             if (mode & DMFSI_O_TRUNC) {
-                // Truncate existing file
+                // Truncate existing file, the space after the end must be zeroed
+                ramfs_gate_close(ctx);
+                if (file->layout & RAMFS_LAYOUT_INLINE) {
+                    ramfs_memset(file->inline_data, 0, RAMFS_INLINE_SIZE);
+                } else {
+                    ramfs_data_release(ctx, file);
+                }
                 file->size = 0;
-                file->position = 0;
+                file->tail = 0;
+                ramfs_gate_open(ctx);
+                file->tier |= RAMFS_TIER_DIRTY;
+                if (ctx->watches != NULL) {
+                    ramfs_notify(ctx, DMFSI_EVENT_MODIFY, file->name, 0);
+                }
             }
         }
     } else {
         // File doesn't exist
         if (!(mode & DMFSI_O_CREAT)) {
+            ramfs_unlock(ctx);
+            Dmod_Free(handle);
             return DMFSI_ERR_NOT_FOUND;
         }
         
-        // Create new file
-        file = (ramfs_file_t*)Dmod_Malloc(sizeof(ramfs_file_t));
+        // Create new file, the name is stored right after the node
+        size_t name_len = ramfs_strlen(path->name);
+        file = (ramfs_file_t*)Dmod_Malloc(sizeof(ramfs_file_t) + path->dir_length + name_len + 1);
         if (file == NULL) {
+            ramfs_unlock(ctx);
+            Dmod_Free(handle);
             return DMFSI_ERR_NO_SPACE;
         }
         
-        ramfs_strncpy(file->name, path, RAMFS_MAX_FILENAME - 1);
-        file->name[RAMFS_MAX_FILENAME - 1] = '\0';
-        file->data = NULL;
+        file->name = (char*)(file + 1);
+        ramfs_memcpy(file->name, path->dir, path->dir_length);
+        ramfs_memcpy(file->name + path->dir_length, path->name, name_len + 1);
+        file->hash = path->hash;
         file->size = 0;
-        file->capacity = 0;
-        file->position = 0;
-        file->flags = mode;
-        file->next = (ramfs_file_t*)ctx->file_list;
-        ctx->file_list = file;
+        file->tail = 0;
+        file->flags = (uint16_t)mode;
+        file->tier = 0;
+        file->layout = RAMFS_LAYOUT_INLINE;
+        ramfs_memset(file->inline_data, 0, RAMFS_INLINE_SIZE);
+        ramfs_gate_close(ctx);
+        int linked = ramfs_file_link(ctx, file);
+        ramfs_gate_open(ctx);
+        if (linked != DMFSI_OK) {
+            ramfs_unlock(ctx);
+            Dmod_Free(file);
+            Dmod_Free(handle);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        if (ctx->watches != NULL) {
+            ramfs_notify(ctx, DMFSI_EVENT_CREATE, file->name, 0);
+        }
     }
     
-    if (mode & DMFSI_O_APPEND) {
-        file->position = file->size;
-    } else {
-        file->position = 0;
+    ramfs_lru_touch(ctx, file);
+    ramfs_unlock(ctx);
+    
+    handle->file = file;
+    handle->mode = mode;
+    handle->position = (mode & DMFSI_O_APPEND) ? RAMFS_ATOMIC_LOAD(&file->size) : 0;
+    
+    *fp = (void*)handle;
+    return DMFSI_OK;
+}
+
+// Implement _fopen for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fopen, (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr) )
+{
+    RAMFS_IO_LOG("RamFS: Opening file '%s' with mode 0x%x\n", path, mode);
+    
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
     }
     
-    *fp = (void*)file;
-    return DMFSI_OK;
+    ramfs_path_t full;
+    ramfs_path_full(&full, path);
+    return ramfs_open(ctx, fp, &full, mode);
 }
 
 // Implement _fclose for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fclose, (dmfsi_context_t ctx, void* fp) )
 {
-    Dmod_Printf("RamFS: Closing file\n");
+    RAMFS_IO_LOG("RamFS: Closing file\n");
     
     if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
         return DMFSI_ERR_INVALID;
     }
     
-    // In this simple implementation, we don't actually close the file,
-    // just mark the handle as invalid
+    if (fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    Dmod_Free(fp);
     return DMFSI_OK;
 }
 
 // Implement _fread for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fread, (dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
     
-    size_t available = file->size - file->position;
-    size_t to_read = (size < available) ? size : available;
-    
-    if (to_read > 0 && file->data != NULL) {
-        ramfs_memcpy(buffer, file->data + file->position, to_read);
-        file->position += to_read;
+    size_t to_read = 0;
+    int result = ramfs_read(ctx, handle->file, handle->position, buffer, size, &to_read);
+    if (result != DMFSI_OK) {
+        *read = 0;
+        return result;
     }
+    handle->position += (uint32_t)to_read;
     
     *read = to_read;
-    Dmod_Printf("RamFS: Read %zu bytes (requested %zu)\n", to_read, size);
+    RAMFS_IO_LOG("RamFS: Read %zu bytes (requested %zu)\n", to_read, size);
     return DMFSI_OK;
 }
 
 // Implement _fwrite for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fwrite, (dmfsi_context_t ctx, void* fp, const void* buffer, size_t size, size_t* written) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
+    ramfs_file_t* file = handle->file;
+    
+    if (size == 0) {
+        *written = 0;
+        return DMFSI_OK;
+    }
+    if (size > UINT32_MAX) {
+        *written = 0;
+        return DMFSI_ERR_NO_SPACE;
+    }
+    
+    int append = (handle->mode & DMFSI_O_APPEND) != 0;
+    uint32_t offset = handle->position;
+    if (!append && (size_t)offset + size > UINT32_MAX) {
+        *written = 0;
+        return DMFSI_ERR_NO_SPACE;
+    }
     
-    // Check if we need to expand the buffer
-    size_t needed = file->position + size;
-    if (needed > file->capacity) {
-        size_t new_capacity = needed * 2; // Double the capacity
-        if (new_capacity < 256) {
-            new_capacity = 256;
+    // Fast path - the data fits in the buffer, copy without the lock
+    int result = DMFSI_ERR_GENERAL;
+    int watched = 0;
+    if (ramfs_gate_enter(ctx)) {
+        watched = (ctx->watches != NULL) && ramfs_watched(ctx, file->name);
+        if (ctx->backing_ctx == NULL && !(file->layout & RAMFS_LAYOUT_SPARSE)) {
+            uint32_t capacity = ramfs_file_capacity(file);
+            if (append) {
+                // Appends reserve their range at the tail, so concurrent writers never overlap.
+                // Only a range that fits is reserved, a failed append leaves no gap.
+                offset = RAMFS_ATOMIC_LOAD(&file->tail);
+                while (size <= capacity && offset <= capacity - size) {
+                    if (RAMFS_ATOMIC_CAS(&file->tail, &offset, offset + (uint32_t)size)) {
+                        result = DMFSI_OK;
+                        break;
+                    }
+                }
+            } else if (offset + size <= capacity) {
+                ramfs_atomic_max(&file->tail, offset + (uint32_t)size);
+                result = DMFSI_OK;
+            }
+            if (result == DMFSI_OK) {
+                ramfs_memcpy(ramfs_file_data(file) + offset, buffer, size);
+                ramfs_atomic_max(&file->size, offset + (uint32_t)size);
+            }
         }
-        
-        uint8_t* new_data = (uint8_t*)Dmod_Malloc(new_capacity);
-        if (new_data == NULL) {
-            *written = 0;
-            return DMFSI_ERR_NO_SPACE;
+        ramfs_gate_leave(ctx);
+    }
+    
+    // Slow path - the buffer is moved or allocated with the lock held and the gate closed,
+    // the lock is also taken to queue the change in a watch that covers the file
+    if (result != DMFSI_OK || watched) {
+        ramfs_lock(ctx);
+        if (result != DMFSI_OK) {
+            ramfs_gate_close(ctx);
+            if (append) {
+                offset = file->tail;
+            }
+            result = ((size_t)offset + size > UINT32_MAX) ? DMFSI_ERR_NO_SPACE
+                   : ramfs_write_locked(ctx, file, offset, buffer, size, append);
+            ramfs_gate_open(ctx);
         }
-        
-        if (file->data != NULL) {
-            ramfs_memcpy(new_data, file->data, file->size);
-            Dmod_Free(file->data);
+        if (result == DMFSI_OK && ctx->watches != NULL) {
+            ramfs_notify(ctx, DMFSI_EVENT_MODIFY, file->name, 0);
         }
-        
-        file->data = new_data;
-        file->capacity = new_capacity;
+        ramfs_unlock(ctx);
     }
+    size_t needed = (size_t)offset + size;
     
-    ramfs_memcpy(file->data + file->position, buffer, size);
-    file->position += size;
-    if (file->position > file->size) {
-        file->size = file->position;
+    if (result != DMFSI_OK) {
+        *written = 0;
+        return result;
     }
     
+    handle->position = (uint32_t)needed;
     *written = size;
-    Dmod_Printf("RamFS: Wrote %zu bytes\n", size);
+    RAMFS_IO_LOG("RamFS: Wrote %zu bytes\n", size);
     return DMFSI_OK;
 }
 
@@ -288,10 +1587,11 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, long, _lseek, (dmfsi_context_t ctx,
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
+    ramfs_file_t* file = handle->file;
     
     long new_pos;
     switch (whence) {
@@ -299,21 +1599,31 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, long, _lseek, (dmfsi_context_t ctx,
             new_pos = offset;
             break;
         case DMFSI_SEEK_CUR:
-            new_pos = file->position + offset;
+            new_pos = handle->position + offset;
             break;
         case DMFSI_SEEK_END:
             new_pos = file->size + offset;
             break;
+        case DMFSI_SEEK_DATA:
+        case DMFSI_SEEK_HOLE:
+            if (offset < 0 || (unsigned long)offset >= file->size) {
+                return DMFSI_ERR_NOT_FOUND;
+            }
+            new_pos = ramfs_seek_extent(file, (uint32_t)offset, whence == DMFSI_SEEK_DATA);
+            if (new_pos < 0) {
+                return new_pos;
+            }
+            break;
         default:
             return DMFSI_ERR_INVALID;
     }
     
-    if (new_pos < 0) {
+    if (new_pos < 0 || (unsigned long)new_pos > UINT32_MAX) {
         return DMFSI_ERR_INVALID;
     }
     
-    file->position = (size_t)new_pos;
-    Dmod_Printf("RamFS: Seek to position %ld\n", new_pos);
+    handle->position = (uint32_t)new_pos;
+    RAMFS_IO_LOG("RamFS: Seek to position %ld\n", new_pos);
     return new_pos;
 }
 
@@ -342,21 +1652,27 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _sync, (dmfsi_context_t ctx, vo
 // Implement _getc for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _getc, (dmfsi_context_t ctx, void* fp) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL || file->position >= file->size) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL || handle->position >= RAMFS_ATOMIC_LOAD(&handle->file->size)) {
+        return -1;
+    }
+    uint8_t c;
+    size_t read = 0;
+    if (ramfs_read(ctx, handle->file, handle->position, &c, 1, &read) != DMFSI_OK || read != 1) {
         return -1;
     }
-    return file->data[file->position++];
+    handle->position++;
+    return c;
 }
 
 // Implement _putc for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _putc, (dmfsi_context_t ctx, void* fp, int c) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
@@ -372,43 +1688,43 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _putc, (dmfsi_context_t ctx, vo
 // Implement _tell for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, long, _tell, (dmfsi_context_t ctx, void* fp) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
-    return (long)file->position;
+    return (long)handle->position;
 }
 
 // Implement _eof for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _eof, (dmfsi_context_t ctx, void* fp) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
-    return (file->position >= file->size) ? 1 : 0;
+    return (handle->position >= RAMFS_ATOMIC_LOAD(&handle->file->size)) ? 1 : 0;
 }
 
 // Implement _size for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, long, _size, (dmfsi_context_t ctx, void* fp) )
 {
-    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)fp;
-    if (file == NULL) {
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL) {
         return DMFSI_ERR_INVALID;
     }
-    return (long)file->size;
+    return (long)RAMFS_ATOMIC_LOAD(&handle->file->size);
 }
 
 // Implement _fflush for RamFS
@@ -432,19 +1748,56 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _error, (dmfsi_context_t ctx, v
     return DMFSI_OK;
 }
 
-// Implement _opendir for RamFS
-dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _opendir, (dmfsi_context_t ctx, void** dp, const char* path) )
+// Helper function to open a directory, the listing is a range of the index
+static int ramfs_dir_open(dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter)
 {
     if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
         return DMFSI_ERR_INVALID;
     }
+    if (dp == NULL || path == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
     
-    Dmod_Printf("RamFS: opendir '%s' (not fully implemented)\n", path);
-    // For simplicity, return the file list as directory handle
-    *dp = ctx->file_list;
+    // The key is the directory path with a '/' and the prefix of the filter
+    size_t path_length = ramfs_tree_length(path);
+    size_t prefix_length = (filter != NULL && filter->prefix != NULL) ? ramfs_strlen(filter->prefix) : 0;
+    ramfs_dir_t* dir = (ramfs_dir_t*)Dmod_Malloc(sizeof(ramfs_dir_t) + path_length + prefix_length + 2);
+    if (dir == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    ramfs_memcpy(dir->key, path, path_length);
+    dir->key[path_length] = '/';
+    dir->key[path_length + 1] = '\0';
+    dir->hash = ramfs_hash(dir->key);
+    ramfs_memcpy(dir->key + path_length + 1, filter != NULL ? filter->prefix : NULL, prefix_length);
+    dir->key[path_length + 1 + prefix_length] = '\0';
+    dir->dir_length = path_length + 1;
+    dir->key_length = path_length + 1 + prefix_length;
+    dir->filtered = (filter != NULL);
+    if (filter != NULL) {
+        dir->filter = *filter;
+        dir->filter.prefix = NULL;      // Already covered by the range
+    }
+    int gated = ramfs_lookup_enter(ctx);
+    dir->position = ramfs_index_lower(ctx, dir->key);
+    ramfs_lookup_leave(ctx, gated);
+    
+    *dp = dir;
     return DMFSI_OK;
 }
 
+// Implement _opendir for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _opendir, (dmfsi_context_t ctx, void** dp, const char* path) )
+{
+    return ramfs_dir_open(ctx, dp, path, NULL);
+}
+
+// Implement _opendir_filter for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _opendir_filter, (dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter) )
+{
+    return ramfs_dir_open(ctx, dp, path, filter);
+}
+
 // Implement _closedir for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _closedir, (dmfsi_context_t ctx, void* dp) )
 {
@@ -452,7 +1805,9 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _closedir, (dmfsi_context_t ctx
         return DMFSI_ERR_INVALID;
     }
     
-    Dmod_Printf("RamFS: closedir\n");
+    if (dp != NULL) {
+        Dmod_Free(dp);
+    }
     return DMFSI_OK;
 }
 
@@ -463,20 +1818,48 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _readdir, (dmfsi_context_t ctx,
         return DMFSI_ERR_INVALID;
     }
     
-    ramfs_file_t* file = (ramfs_file_t*)dp;
-    if (file == NULL) {
-        return DMFSI_ERR_NOT_FOUND;
+    ramfs_dir_t* dir = (ramfs_dir_t*)dp;
+    if (dir == NULL || entry == NULL) {
+        return DMFSI_ERR_INVALID;
     }
     
-    ramfs_strncpy(entry->name, file->name, sizeof(entry->name) - 1);
-    entry->name[sizeof(entry->name) - 1] = '\0';
-    entry->size = file->size;
-    entry->attr = 0;
-    entry->time = 0;
+    int gated = ramfs_lookup_enter(ctx);
+    while (dir->position < ctx->index_count) {
+        ramfs_file_t* file = ctx->index[dir->position];
+        if (!ramfs_starts_with(file->name, dir->key, dir->key_length)) {
+            break;
+        }
+        
+        // Files deeper in the tree show their first directory, once
+        const char* name = file->name + dir->dir_length;
+        size_t length = 0;
+        while (name[length] != '\0' && name[length] != '/') {
+            length++;
+        }
+        if (name[length] == '/') {
+            dir->position = ramfs_index_skip(ctx, dir->position, file->name, dir->dir_length + length + 1);
+            entry->size = 0;
+            entry->attr = DMFSI_ATTR_DIRECTORY;
+        } else {
+            dir->position++;
+            entry->size = RAMFS_ATOMIC_LOAD(&file->size);
+            entry->attr = 0;
+        }
+        if (length > sizeof(entry->name) - 1) {
+            length = sizeof(entry->name) - 1;
+        }
+        ramfs_memcpy(entry->name, name, length);
+        entry->name[length] = '\0';
+        entry->time = 0;
+        
+        if (!dir->filtered || dmfsi_dir_filter_match(&dir->filter, entry->name, entry->attr)) {
+            ramfs_lookup_leave(ctx, gated);
+            return DMFSI_OK;
+        }
+    }
+    ramfs_lookup_leave(ctx, gated);
     
-    // Move to next file
-    // Note: This modifies the dp pointer, which is not ideal but works for this example
-    return DMFSI_OK;
+    return DMFSI_ERR_NOT_FOUND;
 }
 
 // Implement _stat for RamFS
@@ -486,79 +1869,173 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _stat, (dmfsi_context_t ctx, co
         return DMFSI_ERR_INVALID;
     }
     
+    int gated = ramfs_lookup_enter(ctx);
     ramfs_file_t* file = ramfs_find_file(ctx, path);
     if (file == NULL) {
+        ramfs_lookup_leave(ctx, gated);
         return DMFSI_ERR_NOT_FOUND;
     }
     
-    stat->size = file->size;
-    stat->attr = 0;
-    stat->ctime = 0;
-    stat->mtime = 0;
-    stat->atime = 0;
+    ramfs_fill_stat(file, stat);
+    ramfs_lookup_leave(ctx, gated);
     
-    Dmod_Printf("RamFS: stat '%s', size=%u\n", path, stat->size);
+    RAMFS_IO_LOG("RamFS: stat '%s', size=%u\n", path, stat->size);
     return DMFSI_OK;
 }
 
-// Implement _unlink for RamFS
-dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _unlink, (dmfsi_context_t ctx, const char* path) )
+// Implement _fstat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fstat, (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat) )
 {
     if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
         return DMFSI_ERR_INVALID;
     }
     
-    Dmod_Printf("RamFS: unlink '%s'\n", path);
-    
-    ramfs_file_t* file = (ramfs_file_t*)ctx->file_list;
-    ramfs_file_t* prev = NULL;
-    
-    while (file != NULL) {
-        if (ramfs_strcmp(file->name, path) == 0) {
-            if (prev == NULL) {
-                ctx->file_list = file->next;
-            } else {
-                prev->next = file->next;
-            }
-            
-            if (file->data != NULL) {
-                Dmod_Free(file->data);
-            }
-            Dmod_Free(file);
-            return DMFSI_OK;
-        }
-        prev = file;
-        file = file->next;
+    ramfs_handle_t* handle = (ramfs_handle_t*)fp;
+    if (handle == NULL || stat == NULL) {
+        return DMFSI_ERR_INVALID;
     }
     
-    return DMFSI_ERR_NOT_FOUND;
+    ramfs_fill_stat(handle->file, stat);
+    return DMFSI_OK;
 }
 
-// Implement _rename for RamFS
-dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _rename, (dmfsi_context_t ctx, const char* oldpath, const char* newpath) )
+// Implement _stat_many for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _stat_many, (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results) )
 {
     if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
         return DMFSI_ERR_INVALID;
     }
     
-    Dmod_Printf("RamFS: rename '%s' to '%s'\n", oldpath, newpath);
+    if (paths == NULL || stats == NULL || results == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    // Every path is one lookup in the name table
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        ramfs_path_t path;
+        ramfs_path_full(&path, paths[i]);
+        int gated = ramfs_lookup_enter(ctx);
+        ramfs_file_t* file = ramfs_lookup(ctx, &path);
+        if (file != NULL) {
+            ramfs_fill_stat(file, &stats[i]);
+            results[i] = DMFSI_OK;
+            found++;
+        } else {
+            results[i] = DMFSI_ERR_NOT_FOUND;
+        }
+        ramfs_lookup_leave(ctx, gated);
+    }
+    
+    RAMFS_IO_LOG("RamFS: stat_many %zu paths, %d found\n", count, found);
+    return found;
+}
+
+// Helper function to delete a file, the index and the table are changed with the lock like in ramfs_open
+static int ramfs_remove(dmfsi_context_t ctx, const ramfs_path_t* path)
+{
+    ramfs_lock(ctx);
+    ramfs_file_t* file = ramfs_lookup(ctx, path);
+    if (file == NULL) {
+        ramfs_unlock(ctx);
+        return DMFSI_ERR_NOT_FOUND;
+    }
     
-    ramfs_file_t* file = ramfs_find_file(ctx, oldpath);
+    if (ctx->watches != NULL) {
+        ramfs_notify(ctx, DMFSI_EVENT_DELETE, file->name, 0);
+    }
+    ramfs_gate_close(ctx);
+    ramfs_file_unlink(ctx, file);
+    ramfs_file_free(ctx, file);
+    ramfs_gate_open(ctx);
+    ramfs_unlock(ctx);
+    return DMFSI_OK;
+}
+
+// Helper function to rename a file
+static int ramfs_move(dmfsi_context_t ctx, const ramfs_path_t* from, const ramfs_path_t* to)
+{
+    ramfs_lock(ctx);
+    ramfs_file_t* file = ramfs_lookup(ctx, from);
     if (file == NULL) {
+        ramfs_unlock(ctx);
         return DMFSI_ERR_NOT_FOUND;
     }
     
     // Check if new name already exists
-    if (ramfs_find_file(ctx, newpath) != NULL) {
+    if (ramfs_lookup(ctx, to) != NULL) {
+        ramfs_unlock(ctx);
         return DMFSI_ERR_EXISTS;
     }
     
-    ramfs_strncpy(file->name, newpath, RAMFS_MAX_FILENAME - 1);
-    file->name[RAMFS_MAX_FILENAME - 1] = '\0';
+    // Reuse the current name storage when the new name fits in it
+    size_t name_len = ramfs_strlen(to->name);
+    size_t new_len = to->dir_length + name_len;
+    char* name = NULL;
+    if (new_len > ramfs_strlen(file->name)) {
+        name = (char*)Dmod_Malloc(new_len + 1);
+        if (name == NULL) {
+            ramfs_unlock(ctx);
+            return DMFSI_ERR_NO_SPACE;
+        }
+    }
+    if (ctx->watches != NULL) {
+        ramfs_notify(ctx, DMFSI_EVENT_RENAME_FROM, file->name, ++ctx->next_cookie);
+    }
+    ramfs_gate_close(ctx);
+    ramfs_index_remove(ctx, file);
+    ramfs_table_remove(ctx, file);
+    if (name != NULL) {
+        if (file->layout & RAMFS_LAYOUT_NAME_HEAP) {
+            Dmod_Free(file->name);
+        }
+        file->name = name;
+        file->layout |= RAMFS_LAYOUT_NAME_HEAP;
+    }
+    ramfs_memcpy(file->name, to->dir, to->dir_length);
+    ramfs_memcpy(file->name + to->dir_length, to->name, name_len + 1);
+    file->hash = to->hash;
+    ramfs_index_insert(ctx, file);      // Can not fail, the file had a place in the index
+    ramfs_table_insert(ctx, file);
+    ramfs_gate_open(ctx);
+    if (ctx->watches != NULL) {
+        ramfs_notify(ctx, DMFSI_EVENT_RENAME_TO, file->name, ctx->next_cookie);
+    }
+    ramfs_unlock(ctx);
     
     return DMFSI_OK;
 }
 
+// Implement _unlink for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _unlink, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    RAMFS_IO_LOG("RamFS: unlink '%s'\n", path);
+    
+    ramfs_path_t full;
+    ramfs_path_full(&full, path);
+    return ramfs_remove(ctx, &full);
+}
+
+// Implement _rename for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _rename, (dmfsi_context_t ctx, const char* oldpath, const char* newpath) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    RAMFS_IO_LOG("RamFS: rename '%s' to '%s'\n", oldpath, newpath);
+    
+    ramfs_path_t from;
+    ramfs_path_t to;
+    ramfs_path_full(&from, oldpath);
+    ramfs_path_full(&to, newpath);
+    return ramfs_move(ctx, &from, &to);
+}
+
 // Implement _chmod for RamFS
 dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _chmod, (dmfsi_context_t ctx, const char* path, int mode) )
 {
@@ -603,6 +2080,312 @@ dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _direxists, (dmfsi_context_t ct
     return 0;
 }
 
+// Implement _walk for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _walk, (dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC || path == NULL || callback == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    size_t length = ramfs_tree_length(path);
+    int found = 0;
+    int result = DMFSI_OK;
+    dmfsi_stat_t stat;
+    
+    // The root itself is reported only when it is a file
+    if (length > 0 && path[length] == '\0') {
+        int gated = ramfs_lookup_enter(ctx);
+        ramfs_file_t* file = ramfs_find_file(ctx, path);
+        if (file != NULL) {
+            ramfs_fill_stat(file, &stat);
+            found = 1;
+        }
+        ramfs_lookup_leave(ctx, gated);
+        if (found) {
+            result = callback(arg, path, &stat);
+        }
+    }
+    
+    // The files below the root are reported in the order of the index, each after its new directories.
+    // The callbacks get copies of the names and may change the file system, the walk goes on after
+    // the name reported last.
+    char* names[2] = { NULL, NULL };
+    size_t capacities[2] = { 0, 0 };
+    char* previous = NULL;
+    int current = 0;
+    while (result == DMFSI_OK) {
+        uint32_t position;
+        int gated = ramfs_lookup_enter(ctx);
+        uint32_t end = ramfs_tree_range(ctx, path, length, &position);
+        if (previous != NULL) {
+            position = ramfs_index_lower(ctx, previous);
+            if (position < end && ramfs_strcmp(ctx->index[position]->name, previous) == 0) {
+                position++;
+            }
+        }
+        if (position < end) {
+            result = ramfs_name_copy(&names[current], &capacities[current], ctx->index[position]->name);
+            ramfs_fill_stat(ctx->index[position], &stat);
+        }
+        ramfs_lookup_leave(ctx, gated);
+        if (position >= end || result != DMFSI_OK) {
+            break;
+        }
+        
+        char* name = names[current];
+        result = ramfs_walk_dirs(name, previous, length, callback, arg);
+        if (result == DMFSI_OK) {
+            result = callback(arg, name, &stat);
+        }
+        previous = name;
+        current = 1 - current;
+        found = 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (names[i] != NULL) {
+            Dmod_Free(names[i]);
+        }
+    }
+    
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    return (found || length == 0) ? DMFSI_OK : DMFSI_ERR_NOT_FOUND;
+}
+
+// Implement _remove_tree for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _remove_tree, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC || path == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    size_t length = ramfs_tree_length(path);
+    int removed = 0;
+    ramfs_lock(ctx);
+    ramfs_gate_close(ctx);
+    
+    ramfs_file_t* file = (length > 0 && path[length] == '\0') ? ramfs_find_file(ctx, path) : NULL;
+    if (file != NULL) {
+        if (ctx->watches != NULL) {
+            ramfs_notify(ctx, DMFSI_EVENT_DELETE, file->name, 0);
+        }
+        ramfs_file_unlink(ctx, file);
+        ramfs_file_free(ctx, file);
+        removed++;
+    }
+    
+    // The files below the root are one range of the index, it is freed and closed up in one pass.
+    // A file is freed after the next one is checked for new directories, they are counted too.
+    uint32_t first;
+    uint32_t end = ramfs_tree_range(ctx, path, length, &first);
+    ramfs_file_t* previous = NULL;
+    for (uint32_t i = first; i < end; i++) {
+        file = ctx->index[i];
+        removed += ramfs_tree_dirs(file->name, previous ? previous->name : NULL, length) + 1;
+        ramfs_table_remove(ctx, file);
+        if (ctx->watches != NULL) {
+            ramfs_notify(ctx, DMFSI_EVENT_DELETE, file->name, 0);
+        }
+        if (previous != NULL) {
+            ramfs_file_free(ctx, previous);
+        }
+        previous = file;
+    }
+    if (previous != NULL) {
+        ramfs_file_free(ctx, previous);
+        if (length > 0) {
+            removed++;      // The root directory, the file system root is never removed
+        }
+    }
+    for (uint32_t i = end; i < ctx->index_count; i++) {
+        ctx->index[first + (i - end)] = ctx->index[i];
+    }
+    ctx->index_count -= end - first;
+    ramfs_gate_open(ctx);
+    ramfs_unlock(ctx);
+    
+    Dmod_Printf("RamFS: remove_tree '%s', %d files and directories removed\n", path, removed);
+    return (removed > 0 || length == 0) ? removed : DMFSI_ERR_NOT_FOUND;
+}
+
+// Implement _fopenat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _fopenat, (dmfsi_context_t ctx, void** fp, void* dp, const char* name, int mode, int attr) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_path_t path;
+    int result = ramfs_path_at(&path, dp, name);
+    return (result == DMFSI_OK) ? ramfs_open(ctx, fp, &path, mode) : result;
+}
+
+// Implement _statat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _statat, (dmfsi_context_t ctx, void* dp, const char* name, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC || stat == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_path_t path;
+    int result = ramfs_path_at(&path, dp, name);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    int gated = ramfs_lookup_enter(ctx);
+    ramfs_file_t* file = ramfs_lookup(ctx, &path);
+    if (file != NULL) {
+        ramfs_fill_stat(file, stat);
+    }
+    ramfs_lookup_leave(ctx, gated);
+    return (file != NULL) ? DMFSI_OK : DMFSI_ERR_NOT_FOUND;
+}
+
+// Implement _unlinkat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _unlinkat, (dmfsi_context_t ctx, void* dp, const char* name) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_path_t path;
+    int result = ramfs_path_at(&path, dp, name);
+    return (result == DMFSI_OK) ? ramfs_remove(ctx, &path) : result;
+}
+
+// Implement _renameat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _renameat, (dmfsi_context_t ctx, void* olddp, const char* oldname, void* newdp, const char* newname) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_path_t from;
+    ramfs_path_t to;
+    int result = ramfs_path_at(&from, olddp, oldname);
+    if (result == DMFSI_OK) {
+        result = ramfs_path_at(&to, newdp, newname);
+    }
+    return (result == DMFSI_OK) ? ramfs_move(ctx, &from, &to) : result;
+}
+
+// Implement _mkdirat for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _mkdirat, (dmfsi_context_t ctx, void* dp, const char* name, int mode) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    // Directories exist implicitly, as the paths of their files, like in _mkdir
+    ramfs_path_t path;
+    return ramfs_path_at(&path, dp, name);
+}
+
+// Implement _watch_add for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _watch_add, (dmfsi_context_t ctx, void** wp, const char* path, uint32_t mask, size_t queue_length) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC || wp == NULL || path == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    size_t path_length = ramfs_strlen(path);
+    if (path_length == 0 || path_length >= sizeof(((ramfs_watch_t*)0)->path)) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (queue_length == 0) {
+        queue_length = 16;
+    }
+    
+    ramfs_watch_t* watch = (ramfs_watch_t*)Dmod_Malloc(sizeof(ramfs_watch_t));
+    if (watch == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    watch->queue = (dmfsi_event_t*)Dmod_Malloc(queue_length * sizeof(dmfsi_event_t));
+    if (watch->queue == NULL) {
+        Dmod_Free(watch);
+        return DMFSI_ERR_NO_SPACE;
+    }
+    
+    watch->mask = mask;
+    watch->path_length = path_length;
+    ramfs_memcpy(watch->path, path, path_length + 1);
+    watch->queue_length = queue_length;
+    watch->head = 0;
+    watch->count = 0;
+    watch->overflow = 0;
+    
+    // Writers queue the events with the lock held, and check the list with the gate passed
+    ramfs_lock(ctx);
+    ramfs_gate_close(ctx);
+    watch->next = ctx->watches;
+    ctx->watches = watch;
+    ramfs_gate_open(ctx);
+    ramfs_unlock(ctx);
+    
+    Dmod_Printf("RamFS: watching '%s' (mask 0x%x)\n", path, (unsigned)mask);
+    *wp = watch;
+    return DMFSI_OK;
+}
+
+// Implement _watch_read for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _watch_read, (dmfsi_context_t ctx, void* wp, dmfsi_event_t* events, size_t count) )
+{
+    if (!RAMFS_HOT_PATH_CTX_IS_VALID(ctx)) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_watch_t* watch = (ramfs_watch_t*)wp;
+    if (watch == NULL || events == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    size_t taken = 0;
+    ramfs_lock(ctx);
+    while (taken < count && watch->count > 0) {
+        events[taken++] = watch->queue[watch->head];
+        watch->head = (watch->head + 1) % watch->queue_length;
+        watch->count--;
+    }
+    
+    // Lost events are reported after the queued ones
+    if (taken < count && watch->count == 0 && watch->overflow) {
+        events[taken].type = DMFSI_EVENT_OVERFLOW;
+        events[taken].cookie = 0;
+        events[taken].path[0] = '\0';
+        watch->overflow = 0;
+        taken++;
+    }
+    ramfs_unlock(ctx);
+    return (int)taken;
+}
+
+// Implement _watch_remove for RamFS
+dmod_dmfsi_dif_api_declaration( 1.0, ramfs, int, _watch_remove, (dmfsi_context_t ctx, void* wp) )
+{
+    if (!ctx || ctx->magic != RAMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    ramfs_lock(ctx);
+    ramfs_watch_t** link = &ctx->watches;
+    while (*link != NULL) {
+        if (*link == (ramfs_watch_t*)wp) {
+            ramfs_watch_t* watch = *link;
+            ramfs_gate_close(ctx);
+            *link = watch->next;
+            ramfs_gate_open(ctx);
+            ramfs_unlock(ctx);
+            Dmod_Free(watch->queue);
+            Dmod_Free(watch);
+            return DMFSI_OK;
+        }
+        link = &(*link)->next;
+    }
+    ramfs_unlock(ctx);
+    return DMFSI_ERR_NOT_FOUND;
+}
+
 int dmod_init(const Dmod_Config_t *Config)
 {
     Dmod_Printf("RamFS module initialized\n");
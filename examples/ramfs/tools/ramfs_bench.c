@@ -0,0 +1,551 @@
+/**
+ * @brief ramfs_bench - time the data-path operations of RamFS
+ *
+ * Usage: ramfs_bench [-n calls] [-s size] [-f files] [-a threads] [-d files]
+ *                    [-m files]
+ *
+ *   -n calls    calls of every operation (1000000 by default)
+ *   -s size     bytes of every _fread/_fwrite (16 by default)
+ *   -f files    also time a startup scan of that many files, with one
+ *               _stat per path and with one _stat_many
+ *   -a threads  also time the calls split between 1 to that many threads,
+ *               each appending to one shared file with its own handle
+ *   -d files    also time the create, stat, rename and unlink of that many
+ *               files in a deep directory, next to as many other files
+ *   -m files    also create that many small files and print the heap
+ *               bytes taken by each one, e.g. -m 100000
+ *
+ * _fwrite, _fread, _putc and _getc are called through the operations
+ * table, like the generic layer does, on one file that is rewound every
+ * 64 KiB, and the average time of a call is printed. The file is written
+ * once before it is timed, so the writes copy into an existing buffer.
+ *
+ * The cost of re-validating the context in every call is the difference
+ * between a build configured with -DDMFSI_VALIDATE_HOT_PATH=ON (the
+ * default) and one with OFF, the tool prints which one it is.
+ *
+ * _getc and _fread are also timed through the three ways of calling an
+ * implementation: a DIF lookup of the function on every call, the
+ * operations table, and DMFSI_CALL with DMFSI_STATIC_IMPL, which calls
+ * RamFS directly. The DIF lookup is skipped when RamFS is not registered
+ * as a DMOD module. The tool is built with RamFS compiled in, with
+ * RAMFS_LOG_IO=0.
+ *
+ * Appends in the file buffer take no lock, the append mode is timed again
+ * with a watch on another directory, which must not change that.
+ *
+ * The deep directory mode calls the operations once with the absolute
+ * paths and once with the names relative to a handle of the directory
+ * (_fopenat, _statat, _renameat, _unlinkat), and prints the average time
+ * of an operation for both.
+ *
+ * The small file mode writes 10 bytes to every file. The heap is measured
+ * with mallinfo2 of glibc before and after, so the bytes per file include
+ * the allocator headers and the growth of the name table and the index.
+ * Other C libraries only get the time.
+ *
+ * Built with the examples in DMOD_SYSTEM mode, it links RamFS statically
+ * (see DMFSI_STATIC_OPS).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#   include <malloc.h>
+#   define BENCH_HEAP_BYTES()  ((long long)mallinfo2().uordblks)
+#else
+#   define BENCH_HEAP_BYTES()  (-1LL)
+#endif
+
+// DMFSI_CALL calls RamFS directly, the operations table is still called through pointers
+#undef DMFSI_STATIC_IMPL
+#define DMFSI_STATIC_IMPL ramfs
+
+#include "dmod.h"
+#include "dmfsi.h"
+
+#define BENCH_FILE_SIZE     (64 * 1024)
+#define BENCH_MAX_SIZE      4096
+#define BENCH_PATH_LENGTH   48
+#define BENCH_DEEP_LENGTH   96
+#define BENCH_SMALL_SIZE    10
+#define BENCH_DEEP_DIR      "/var/data/sensors/station_0042/calibrated/raw"
+
+static dmfsi_ops_t ops;
+static dmfsi_context_t ctx;
+static void* fp;
+static long calls = 1000000;
+static size_t size = 16;
+static unsigned char buffer[BENCH_MAX_SIZE];
+static long files = 0;
+static long threads = 0;
+static long deep_files = 0;
+static long small_files = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Rewind the file when the next transfer of `bytes` would pass its end
+static void rewind_at_end(long* position, size_t bytes)
+{
+    if (*position + (long)bytes > BENCH_FILE_SIZE) {
+        ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+        *position = 0;
+    }
+}
+
+static double bench_fwrite(void)
+{
+    long position = 0;
+    size_t written;
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, size);
+        ops.fwrite(ctx, fp, buffer, size, &written);
+        position += (long)written;
+    }
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+static double bench_fread(void)
+{
+    long position = 0;
+    size_t read;
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, size);
+        ops.fread(ctx, fp, buffer, size, &read);
+        position += (long)read;
+    }
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+static double bench_putc(void)
+{
+    long position = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, 1);
+        ops.putc(ctx, fp, 'x');
+        position++;
+    }
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+static double bench_getc(void)
+{
+    long position = 0;
+    volatile int sink = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, 1);
+        sink += ops.getc(ctx, fp);
+        position++;
+    }
+    (void)sink;
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+typedef int (*bench_getc_fn_t)(dmfsi_context_t ctx, void* fp);
+typedef int (*bench_fread_fn_t)(dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read);
+
+// Ways of calling an implementation
+#define BENCH_DIF       0   // Dmod_GetDifFunction on every call
+#define BENCH_TABLE     1   // dmfsi_ops_t
+#define BENCH_DIRECT    2   // DMFSI_CALL with DMFSI_STATIC_IMPL
+
+static double bench_dispatch_getc(Dmod_Context_t* module, int variant)
+{
+    long position = 0;
+    volatile int sink = 0;
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, 1);
+        if (variant == BENCH_DIF) {
+            bench_getc_fn_t getc_fn = (bench_getc_fn_t)Dmod_GetDifFunction(module, dmod_dmfsi_getc_sig);
+            sink += getc_fn(ctx, fp);
+        } else if (variant == BENCH_TABLE) {
+            sink += ops.getc(ctx, fp);
+        } else {
+            sink += DMFSI_CALL(&ops, getc)(ctx, fp);
+        }
+        position++;
+    }
+    (void)sink;
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+static double bench_dispatch_fread(Dmod_Context_t* module, int variant)
+{
+    long position = 0;
+    size_t read;
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+    uint64_t start = now_ns();
+    for (long i = 0; i < calls; i++) {
+        rewind_at_end(&position, size);
+        if (variant == BENCH_DIF) {
+            bench_fread_fn_t fread_fn = (bench_fread_fn_t)Dmod_GetDifFunction(module, dmod_dmfsi_fread_sig);
+            fread_fn(ctx, fp, buffer, size, &read);
+        } else if (variant == BENCH_TABLE) {
+            ops.fread(ctx, fp, buffer, size, &read);
+        } else {
+            DMFSI_CALL(&ops, fread)(ctx, fp, buffer, size, &read);
+        }
+        position += (long)read;
+    }
+    return (double)(now_ns() - start) / (double)calls;
+}
+
+// Find RamFS among the registered DMOD modules, NULL when it is only linked statically
+static Dmod_Context_t* bench_find_module(void)
+{
+    Dmod_Context_t* module = Dmod_GetNextDifModule(dmod_dmfsi_init_sig, NULL);
+    while (module != NULL) {
+        const char* name = Dmod_GetName(module);
+        if (name != NULL && strcmp(name, "ramfs") == 0
+            && Dmod_GetDifFunction(module, dmod_dmfsi_getc_sig) != NULL
+            && Dmod_GetDifFunction(module, dmod_dmfsi_fread_sig) != NULL) {
+            return module;
+        }
+        module = Dmod_GetNextDifModule(dmod_dmfsi_init_sig, module);
+    }
+    return NULL;
+}
+
+static void bench_dispatch(void)
+{
+    Dmod_Context_t* module = bench_find_module();
+    printf("dispatch         DIF lookup   ops table  DMFSI_CALL (ns/call)\n");
+    for (int op = 0; op < 2; op++) {
+        printf("  %-6s", op == 0 ? "getc" : "fread");
+        for (int variant = BENCH_DIF; variant <= BENCH_DIRECT; variant++) {
+            if (variant == BENCH_DIF && module == NULL) {
+                printf("  %10s", "-");
+                continue;
+            }
+            double ns = (op == 0) ? bench_dispatch_getc(module, variant) : bench_dispatch_fread(module, variant);
+            printf("  %10.2f", ns);
+        }
+        printf("\n");
+    }
+    if (module == NULL) {
+        printf("  (RamFS is not registered as a DMOD module, no DIF lookup)\n");
+    }
+}
+
+// Check that every file of a scan exists, e.g. the assets of an application at startup
+static void bench_scan(void)
+{
+    char* names = malloc((size_t)files * BENCH_PATH_LENGTH);
+    const char** paths = malloc((size_t)files * sizeof(char*));
+    dmfsi_stat_t* stats = malloc((size_t)files * sizeof(dmfsi_stat_t));
+    int* results = malloc((size_t)files * sizeof(int));
+    if (names == NULL || paths == NULL || stats == NULL || results == NULL) {
+        fprintf(stderr, "ramfs_bench: not enough memory for %ld files\n", files);
+        return;
+    }
+    for (long i = 0; i < files; i++) {
+        void* file;
+        char* path = names + i * BENCH_PATH_LENGTH;
+        snprintf(path, BENCH_PATH_LENGTH, "/assets/%ld/asset_%ld.bin", i % 50, i);
+        paths[i] = path;
+        if (ops.fopen(ctx, &file, paths[i], DMFSI_O_WRONLY | DMFSI_O_CREAT, 0) == DMFSI_OK) {
+            ops.fclose(ctx, file);
+        }
+    }
+
+    int found = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < files; i++) {
+        found += (ops.stat(ctx, paths[i], &stats[i]) == DMFSI_OK);
+    }
+    uint64_t loop = now_ns() - start;
+    printf("scan of %ld files\n", files);
+    printf("  stat      %10.3f ms, %d found\n", (double)loop / 1e6, found);
+
+    start = now_ns();
+    found = ops.stat_many(ctx, paths, (size_t)files, stats, results);
+    uint64_t many = now_ns() - start;
+    printf("  stat_many %10.3f ms, %d found\n", (double)many / 1e6, found);
+
+    free(names);
+    free(paths);
+    free(stats);
+    free(results);
+}
+
+typedef struct {
+    pthread_t thread;
+    long calls;
+    int result;
+} append_thread_t;
+
+static void* append_thread(void* arg)
+{
+    append_thread_t* thread = (append_thread_t*)arg;
+    void* file;
+    size_t written;
+    thread->result = ops.fopen(ctx, &file, "/append", DMFSI_O_WRONLY | DMFSI_O_CREAT | DMFSI_O_APPEND, 0);
+    for (long i = 0; i < thread->calls && thread->result == DMFSI_OK; i++) {
+        thread->result = ops.fwrite(ctx, file, buffer, size, &written);
+    }
+    if (thread->result == DMFSI_OK) {
+        ops.fclose(ctx, file);
+    }
+    return NULL;
+}
+
+// Append all the calls to a new file from @p count threads, the file must have every byte once
+static void bench_append_run(long count)
+{
+    append_thread_t* list = malloc((size_t)count * sizeof(append_thread_t));
+    if (list == NULL) {
+        return;
+    }
+    ops.unlink(ctx, "/append");
+    
+    uint64_t start = now_ns();
+    for (long i = 0; i < count; i++) {
+        list[i].calls = calls / count + (i < calls % count);
+        list[i].result = DMFSI_ERR_GENERAL;
+        pthread_create(&list[i].thread, NULL, append_thread, &list[i]);
+    }
+    int failed = 0;
+    for (long i = 0; i < count; i++) {
+        pthread_join(list[i].thread, NULL);
+        failed |= (list[i].result != DMFSI_OK);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    dmfsi_stat_t stat;
+    int complete = !failed && ops.stat(ctx, "/append", &stat) == DMFSI_OK
+                && stat.size == (uint32_t)((size_t)calls * size);
+    printf("  %3ld threads %8.2f ns/call %9.1f MiB/s%s\n", count, (double)elapsed / (double)calls,
+           (double)calls * (double)size / ((double)elapsed / 1e9) / (1024.0 * 1024.0),
+           complete ? "" : "  (size mismatch or error)");
+    free(list);
+}
+
+// Concurrent appends to one file, e.g. a shared log
+static void bench_append(void)
+{
+    printf("appends of %ld calls, %zu bytes each\n", calls, size);
+    for (long count = 1; count <= threads; count++) {
+        bench_append_run(count);
+    }
+    
+    void* watch;
+    if (ops.watch_add(ctx, &watch, "/other", DMFSI_EVENT_MODIFY, 16) == DMFSI_OK) {
+        printf("with a watch on another directory\n");
+        bench_append_run(threads);
+        ops.watch_remove(ctx, watch);
+    }
+    ops.unlink(ctx, "/append");
+}
+
+// Operations of the deep directory mode
+#define BENCH_DEEP_CREATE   0
+#define BENCH_DEEP_STAT     1
+#define BENCH_DEEP_RENAME   2
+#define BENCH_DEEP_UNLINK   3
+#define BENCH_DEEP_COUNT    4
+
+// Call one operation on every file, by absolute path or by name relative to @p dp
+static double bench_deep_run(int operation, void* dp, char* from, char* to, int* failed)
+{
+    const size_t name_offset = sizeof(BENCH_DEEP_DIR);
+    uint64_t start = now_ns();
+    for (long i = 0; i < deep_files; i++) {
+        const char* from_path = from + i * BENCH_DEEP_LENGTH;
+        const char* to_path = to + i * BENCH_DEEP_LENGTH;
+        const char* from_name = from_path + name_offset;
+        const char* to_name = to_path + name_offset;
+        void* file;
+        dmfsi_stat_t stat;
+        int result;
+        if (operation == BENCH_DEEP_CREATE) {
+            result = (dp == NULL) ? ops.fopen(ctx, &file, from_path, DMFSI_O_WRONLY | DMFSI_O_CREAT, 0)
+                                  : ops.fopenat(ctx, &file, dp, from_name, DMFSI_O_WRONLY | DMFSI_O_CREAT, 0);
+            if (result == DMFSI_OK) {
+                ops.fclose(ctx, file);
+            }
+        } else if (operation == BENCH_DEEP_STAT) {
+            result = (dp == NULL) ? ops.stat(ctx, from_path, &stat)
+                                  : ops.statat(ctx, dp, from_name, &stat);
+        } else if (operation == BENCH_DEEP_RENAME) {
+            result = (dp == NULL) ? ops.rename(ctx, from_path, to_path)
+                                  : ops.renameat(ctx, dp, from_name, dp, to_name);
+        } else {
+            result = (dp == NULL) ? ops.unlink(ctx, to_path)
+                                  : ops.unlinkat(ctx, dp, to_name);
+        }
+        *failed |= (result != DMFSI_OK);
+    }
+    return (double)(now_ns() - start) / (double)deep_files / 1000.0;
+}
+
+// Files of a deep directory, e.g. the samples of a data logger, among other files
+static void bench_deep(void)
+{
+    char* from = malloc((size_t)deep_files * BENCH_DEEP_LENGTH);
+    char* to = malloc((size_t)deep_files * BENCH_DEEP_LENGTH);
+    if (from == NULL || to == NULL) {
+        fprintf(stderr, "ramfs_bench: not enough memory for %ld files\n", deep_files);
+        free(from);
+        free(to);
+        return;
+    }
+    char path[BENCH_DEEP_LENGTH];
+    for (long i = 0; i < deep_files; i++) {
+        void* file;
+        snprintf(from + i * BENCH_DEEP_LENGTH, BENCH_DEEP_LENGTH, "%s/sample_%ld.bin", BENCH_DEEP_DIR, i);
+        snprintf(to + i * BENCH_DEEP_LENGTH, BENCH_DEEP_LENGTH, "%s/sample_%ld.old", BENCH_DEEP_DIR, i);
+        snprintf(path, sizeof(path), "/var/data/other/%ld/file_%ld.bin", i % 50, i);
+        if (ops.fopen(ctx, &file, path, DMFSI_O_WRONLY | DMFSI_O_CREAT, 0) == DMFSI_OK) {
+            ops.fclose(ctx, file);
+        }
+    }
+
+    void* dp = NULL;
+    if (ops.opendir(ctx, &dp, BENCH_DEEP_DIR) != DMFSI_OK) {
+        fprintf(stderr, "ramfs_bench: cannot open %s\n", BENCH_DEEP_DIR);
+        free(from);
+        free(to);
+        return;
+    }
+    double times[2][BENCH_DEEP_COUNT];
+    int failed = 0;
+    for (int relative = 0; relative < 2; relative++) {
+        for (int operation = 0; operation < BENCH_DEEP_COUNT; operation++) {
+            times[relative][operation] = bench_deep_run(operation, relative ? dp : NULL, from, to, &failed);
+        }
+    }
+    ops.closedir(ctx, dp);
+
+    static const char* const names[BENCH_DEEP_COUNT] = { "create", "stat", "rename", "unlink" };
+    printf("deep directory of %ld files (%s), %ld other files\n", deep_files, BENCH_DEEP_DIR, deep_files);
+    printf("            absolute   relative (us/op)\n");
+    for (int operation = 0; operation < BENCH_DEEP_COUNT; operation++) {
+        printf("  %-6s  %10.3f %10.3f\n", names[operation], times[0][operation], times[1][operation]);
+    }
+    if (failed) {
+        printf("  (an operation failed)\n");
+    }
+    free(from);
+    free(to);
+}
+
+// Memory of many small files, e.g. the configuration and state files of an application
+static void bench_small(void)
+{
+    char path[BENCH_PATH_LENGTH];
+    int failed = 0;
+    memset(buffer, 's', BENCH_SMALL_SIZE);
+    long long before = BENCH_HEAP_BYTES();
+    uint64_t start = now_ns();
+    for (long i = 0; i < small_files; i++) {
+        void* file;
+        size_t written = 0;
+        snprintf(path, sizeof(path), "/small/%ld/file_%ld.cfg", i % 100, i);
+        int result = ops.fopen(ctx, &file, path, DMFSI_O_WRONLY | DMFSI_O_CREAT, 0);
+        if (result == DMFSI_OK) {
+            result = ops.fwrite(ctx, file, buffer, BENCH_SMALL_SIZE, &written);
+            ops.fclose(ctx, file);
+        }
+        failed |= (result != DMFSI_OK || written != BENCH_SMALL_SIZE);
+    }
+    uint64_t elapsed = now_ns() - start;
+    long long after = BENCH_HEAP_BYTES();
+
+    printf("%ld files of %d bytes\n", small_files, BENCH_SMALL_SIZE);
+    printf("  create  %8.3f us/file\n", (double)elapsed / (double)small_files / 1000.0);
+    if (before >= 0 && after >= 0) {
+        printf("  heap    %8.1f bytes/file (%lld bytes)\n",
+               (double)(after - before) / (double)small_files, after - before);
+    } else {
+        printf("  heap    not measured, no mallinfo2\n");
+    }
+    if (failed) {
+        printf("  (an operation failed)\n");
+    }
+    ops.remove_tree(ctx, "/small");
+}
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            calls = atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+            size = (size_t)atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            files = atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "-a") == 0 && arg + 1 < argc) {
+            threads = atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            deep_files = atol(argv[++arg]);
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            small_files = atol(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || calls < 1 || size < 1 || size > BENCH_MAX_SIZE || files < 0 || threads < 0
+        || deep_files < 0 || small_files < 0) {
+        fprintf(stderr, "Usage: %s [-n calls] [-s size] [-f files] [-a threads] [-d files] [-m files]\n", argv[0]);
+        fprintf(stderr, "       size is 1 to %d bytes\n", BENCH_MAX_SIZE);
+        return 1;
+    }
+
+    ops = DMFSI_STATIC_OPS(ramfs);
+    ctx = ops.init(NULL);
+    if (ctx == NULL || ops.fopen(ctx, &fp, "/bench", DMFSI_O_RDWR | DMFSI_O_CREAT, 0) != DMFSI_OK) {
+        fprintf(stderr, "ramfs_bench: cannot create the file\n");
+        return 1;
+    }
+
+    // Allocate the whole file, so only the copies are timed
+    memset(buffer, 'x', sizeof(buffer));
+    size_t written;
+    for (long position = 0; position < BENCH_FILE_SIZE; position += (long)sizeof(buffer)) {
+        ops.fwrite(ctx, fp, buffer, sizeof(buffer), &written);
+    }
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+
+    printf("context validation in the data path: %s\n", DMFSI_VALIDATE_HOT_PATH ? "on" : "off");
+    printf("%ld calls, %zu bytes per read/write\n", calls, size);
+    printf("  fwrite  %8.2f ns/call\n", bench_fwrite());
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+    printf("  fread   %8.2f ns/call\n", bench_fread());
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+    printf("  putc    %8.2f ns/call\n", bench_putc());
+    ops.lseek(ctx, fp, 0, DMFSI_SEEK_SET);
+    printf("  getc    %8.2f ns/call\n", bench_getc());
+    bench_dispatch();
+    if (files > 0) {
+        bench_scan();
+    }
+    if (threads > 0) {
+        bench_append();
+    }
+    if (deep_files > 0) {
+        bench_deep();
+    }
+    if (small_files > 0) {
+        bench_small();
+    }
+
+    ops.fclose(ctx, fp);
+    ops.deinit(ctx);
+    return 0;
+}
@@ -0,0 +1,756 @@
+#define DMOD_ENABLE_REGISTRATION    ON
+#ifndef DMOD_romfs
+#   define DMOD_romfs
+#endif
+
+#include "dmod.h"
+#include "dmfsi.h"
+#include "romfs.h"
+#include "romfs_image.h"
+
+/**
+ * @brief RomFS - Read-only packed image file system
+ *
+ * Example implementation of the DMFSI interface that serves files straight
+ * from an image created by the host-side tool (tools/mkromfs.c). The image
+ * is used in place, so the data is not duplicated in RAM:
+ *
+ *  - mount only validates the header - it does not depend on the number of
+ *    files
+ *  - lookups are binary searches in the sorted index of the image
+ *  - _fread is a bounded copy, ROMFS_IOCTL_GET_VIEW gives a pointer to the
+ *    data without any copy
+ *  - file handles come from a pool allocated with the context, so nothing
+ *    is allocated per file
+ *
+ * Example config strings:
+ *
+ *      addr=0x08040000;size=131072     image in memory (flash, or a mmap'd file)
+ *      file=/tmp/www.img;handles=16    image loaded from a file into one buffer
+ */
+
+#define ROMFS_CONTEXT_MAGIC     0x524F4D46  // "ROMF" in hex
+#define ROMFS_DEFAULT_HANDLES   8
+#define ROMFS_MAX_PATH          256
+
+// Context check of operations on an opened handle (see DMFSI_VALIDATE_HOT_PATH)
+#if DMFSI_VALIDATE_HOT_PATH
+#   define ROMFS_HOT_PATH_CTX_IS_VALID(ctx)    ((ctx) != NULL && (ctx)->magic == ROMFS_CONTEXT_MAGIC)
+#else
+#   define ROMFS_HOT_PATH_CTX_IS_VALID(ctx)    1
+#endif
+
+// File handle structure
+typedef struct romfs_handle_s {
+    const romfs_image_entry_t* entry;   // NULL when the handle is free
+    const uint8_t* data;
+    uint32_t position;
+    struct romfs_handle_s* next_free;
+} romfs_handle_t;
+
+// Directory handle structure
+typedef struct {
+    uint32_t index;             // Next entry to report
+    uint32_t end;               // End of the entries inside the directory
+    uint32_t prefix_length;     // Length of the directory path with the trailing '/'
+} romfs_dir_t;
+
+// Context structure definition
+struct dmfsi_context {
+    uint32_t magic;
+    const uint8_t* base;                    // First byte of the image
+    uint32_t size;                          // Size of the image
+    const romfs_image_header_t* header;
+    const romfs_image_entry_t* entries;
+    uint8_t* buffer;                        // Image loaded from a file, NULL if used in place
+    romfs_handle_t* free_handles;
+    uint32_t handle_count;
+    romfs_handle_t handles[];
+};
+
+// Helper functions to replace stdlib functions
+static size_t romfs_strlen(const char* s)
+{
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+static void* romfs_memcpy(void* dest, const void* src, size_t n)
+{
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+    return dest;
+}
+
+// Helper function to find the value of an option in a `key=value;` config string
+static const char* romfs_config_find(const char* config, const char* key)
+{
+    const char* p = config;
+    while (p != NULL && *p) {
+        const char* k = key;
+        const char* v = p;
+        while (*k && *v == *k) {
+            k++;
+            v++;
+        }
+        if (*k == '\0' && *v == '=') {
+            return v + 1;
+        }
+        while (*p && *p != ';') {
+            p++;
+        }
+        if (*p == ';') {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+// Helper function to parse a decimal or 0x-prefixed hexadecimal option
+static uintptr_t romfs_config_number(const char* config, const char* key, uintptr_t def)
+{
+    const char* v = romfs_config_find(config, key);
+    if (v == NULL || *v < '0' || *v > '9') {
+        return def;
+    }
+    uintptr_t value = 0;
+    if (v[0] == '0' && (v[1] == 'x' || v[1] == 'X')) {
+        for (v += 2; ; v++) {
+            if (*v >= '0' && *v <= '9') {
+                value = value * 16 + (uintptr_t)(*v - '0');
+            } else if (*v >= 'a' && *v <= 'f') {
+                value = value * 16 + (uintptr_t)(*v - 'a' + 10);
+            } else if (*v >= 'A' && *v <= 'F') {
+                value = value * 16 + (uintptr_t)(*v - 'A' + 10);
+            } else {
+                break;
+            }
+        }
+        return value;
+    }
+    while (*v >= '0' && *v <= '9') {
+        value = value * 10 + (uintptr_t)(*v - '0');
+        v++;
+    }
+    if (*v == 'k' || *v == 'K') {
+        value *= 1024;
+    } else if (*v == 'm' || *v == 'M') {
+        value *= 1024 * 1024;
+    }
+    return value;
+}
+
+// Helper function to get the path of an entry, NULL if it is outside of the image
+static const char* romfs_entry_name(dmfsi_context_t ctx, const romfs_image_entry_t* entry)
+{
+    if (entry->name_offset >= ctx->size || entry->name_length >= ctx->size - entry->name_offset) {
+        return NULL;
+    }
+    return (const char*)ctx->base + entry->name_offset;
+}
+
+// Helper function to compare a path with the first `length` bytes of `key`
+static int romfs_compare(const char* name, const char* key, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        unsigned char a = (unsigned char)name[i];
+        unsigned char b = (unsigned char)key[i];
+        if (a != b) {
+            return (a < b) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Helper function to find the first entry that does not sort before `key`
+// (or, with `after`, the first entry after all entries starting with `key`)
+static uint32_t romfs_lower_bound(dmfsi_context_t ctx, const char* key, size_t length, int after)
+{
+    uint32_t lo = 0;
+    uint32_t hi = ctx->header->file_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const char* name = romfs_entry_name(ctx, &ctx->entries[mid]);
+        int cmp = (name != NULL) ? romfs_compare(name, key, length) : 1;
+        if (cmp < 0 || (after && cmp == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Helper function to find an entry by path
+static const romfs_image_entry_t* romfs_find_entry(dmfsi_context_t ctx, const char* path)
+{
+    size_t length = romfs_strlen(path);
+    uint32_t index = romfs_lower_bound(ctx, path, length, 0);
+    if (index < ctx->header->file_count) {
+        const romfs_image_entry_t* entry = &ctx->entries[index];
+        const char* name = romfs_entry_name(ctx, entry);
+        if (name != NULL && entry->name_length == length && romfs_compare(name, path, length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Helper function to build the prefix of the entries inside a directory
+static int romfs_dir_prefix(const char* path, char* prefix)
+{
+    size_t length = romfs_strlen(path);
+    if (length + 2 > ROMFS_MAX_PATH) {
+        return -1;
+    }
+    romfs_memcpy(prefix, path, length);
+    if (length == 0 || prefix[length - 1] != '/') {
+        prefix[length++] = '/';
+    }
+    prefix[length] = '\0';
+    return (int)length;
+}
+
+static void romfs_fill_stat(const romfs_image_entry_t* entry, dmfsi_stat_t* stat)
+{
+    stat->size = entry->size;
+    stat->attr = entry->attr | DMFSI_ATTR_READONLY;
+    stat->ctime = entry->mtime;
+    stat->mtime = entry->mtime;
+    stat->atime = entry->mtime;
+}
+
+// Validate the image header - the entries are checked when they are used
+static int romfs_mount(dmfsi_context_t ctx)
+{
+    const romfs_image_header_t* header = (const romfs_image_header_t*)ctx->base;
+    if (((uintptr_t)ctx->base & 3) != 0 || ctx->size < sizeof(romfs_image_header_t)) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (header->magic != ROMFS_IMAGE_MAGIC || header->version != ROMFS_IMAGE_VERSION
+        || header->header_size != sizeof(romfs_image_header_t)
+        || header->image_size > ctx->size
+        || (header->index_offset & 3) != 0
+        || header->index_offset > header->image_size
+        || header->file_count > (header->image_size - header->index_offset) / sizeof(romfs_image_entry_t)) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (header->data_align != 0 && ((uintptr_t)ctx->base % header->data_align) != 0) {
+        Dmod_Printf("RomFS: Image is not aligned to %u bytes, file data is unaligned\n", header->data_align);
+    }
+
+    ctx->size = header->image_size;
+    ctx->header = header;
+    ctx->entries = (const romfs_image_entry_t*)(ctx->base + header->index_offset);
+    return DMFSI_OK;
+}
+
+// Load the image from a file into a single buffer
+static int romfs_load_file(dmfsi_context_t ctx, const char* config)
+{
+    char path[ROMFS_MAX_PATH];
+    const char* v = romfs_config_find(config, "file");
+    size_t len = 0;
+    while (v[len] && v[len] != ';' && len < sizeof(path) - 1) {
+        path[len] = v[len];
+        len++;
+    }
+    path[len] = '\0';
+
+    void* file = Dmod_FileOpen(path, "rb");
+    if (file == NULL) {
+        Dmod_Printf("RomFS: Cannot open image '%s'\n", path);
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    size_t size = Dmod_FileSize(file);
+    ctx->buffer = (size > 0 && size <= 0xFFFFFFFFu) ? (uint8_t*)Dmod_Malloc(size) : NULL;
+    int result = DMFSI_OK;
+    if (ctx->buffer == NULL) {
+        result = DMFSI_ERR_NO_SPACE;
+    } else if (Dmod_FileRead(ctx->buffer, 1, size, file) != size) {
+        result = DMFSI_ERR_GENERAL;
+    }
+    Dmod_FileClose(file);
+
+    ctx->base = ctx->buffer;
+    ctx->size = (uint32_t)size;
+    return result;
+}
+
+// Implement _init for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, dmfsi_context_t, _init, (const char* config) )
+{
+    Dmod_Printf("RomFS: Initializing file system\n");
+
+    uint32_t handle_count = (uint32_t)romfs_config_number(config, "handles", ROMFS_DEFAULT_HANDLES);
+    struct dmfsi_context* ctx = (struct dmfsi_context*)Dmod_Malloc(
+        sizeof(struct dmfsi_context) + handle_count * sizeof(romfs_handle_t));
+    if (ctx == NULL) {
+        Dmod_Printf("RomFS: Failed to allocate context\n");
+        return NULL;
+    }
+
+    ctx->magic = ROMFS_CONTEXT_MAGIC;
+    ctx->base = NULL;
+    ctx->size = 0;
+    ctx->buffer = NULL;
+    ctx->handle_count = handle_count;
+    ctx->free_handles = NULL;
+    for (uint32_t i = handle_count; i > 0; i--) {
+        ctx->handles[i - 1].entry = NULL;
+        ctx->handles[i - 1].next_free = ctx->free_handles;
+        ctx->free_handles = &ctx->handles[i - 1];
+    }
+
+    int result = DMFSI_ERR_INVALID;
+    uintptr_t addr = romfs_config_number(config, "addr", 0);
+    if (addr != 0) {
+        ctx->base = (const uint8_t*)addr;
+        ctx->size = (uint32_t)romfs_config_number(config, "size", 0);
+        if (ctx->size == 0 && (addr & 3) == 0) {
+            ctx->size = ((const romfs_image_header_t*)ctx->base)->image_size;
+        }
+        result = DMFSI_OK;
+    } else if (romfs_config_find(config, "file") != NULL) {
+        result = romfs_load_file(ctx, config);
+    } else {
+        Dmod_Printf("RomFS: 'addr' or 'file' option is required\n");
+    }
+    if (result == DMFSI_OK) {
+        result = romfs_mount(ctx);
+    }
+    if (result != DMFSI_OK) {
+        Dmod_Printf("RomFS: Failed to mount image\n");
+        if (ctx->buffer != NULL) {
+            Dmod_Free(ctx->buffer);
+        }
+        Dmod_Free(ctx);
+        return NULL;
+    }
+
+    Dmod_Printf("RomFS: Mounted %u files, %u bytes\n", ctx->header->file_count, ctx->size);
+    return ctx;
+}
+
+// Implement _deinit for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _deinit, (dmfsi_context_t ctx) )
+{
+    Dmod_Printf("RomFS: Deinitializing file system\n");
+
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    if (ctx->buffer != NULL) {
+        Dmod_Free(ctx->buffer);
+    }
+    ctx->magic = 0xDEADBEEF;
+    Dmod_Free(ctx);
+    return DMFSI_OK;
+}
+
+// Implement _context_is_valid for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _context_is_valid, (dmfsi_context_t ctx) )
+{
+    return (ctx != NULL && ctx->magic == ROMFS_CONTEXT_MAGIC) ? 1 : 0;
+}
+
+// Implement _fopen for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fopen, (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // Read-only file system
+    if ((mode & (DMFSI_O_WRONLY | DMFSI_O_CREAT | DMFSI_O_TRUNC | DMFSI_O_APPEND)) != 0) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    const romfs_image_entry_t* entry = romfs_find_entry(ctx, path);
+    if (entry == NULL) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    if (entry->data_offset > ctx->size || entry->size > ctx->size - entry->data_offset) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_handle_t* handle = ctx->free_handles;
+    if (handle == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    ctx->free_handles = handle->next_free;
+
+    handle->entry = entry;
+    handle->data = ctx->base + entry->data_offset;
+    handle->position = 0;
+    *fp = handle;
+    return DMFSI_OK;
+}
+
+// Implement _fclose for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fclose, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_handle_t* handle = (romfs_handle_t*)fp;
+    if (handle->entry == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    handle->entry = NULL;
+    handle->next_free = ctx->free_handles;
+    ctx->free_handles = handle;
+    return DMFSI_OK;
+}
+
+// Implement _fread for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fread, (dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read) )
+{
+    if (!ROMFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_handle_t* handle = (romfs_handle_t*)fp;
+    uint32_t file_size = handle->entry->size;
+    size_t available = (handle->position < file_size) ? file_size - handle->position : 0;
+    size_t to_read = (size < available) ? size : available;
+
+    romfs_memcpy(buffer, handle->data + handle->position, to_read);
+    handle->position += (uint32_t)to_read;
+    *read = to_read;
+    return DMFSI_OK;
+}
+
+// Implement _fwrite for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fwrite, (dmfsi_context_t ctx, void* fp, const void* buffer, size_t size, size_t* written) )
+{
+    *written = 0;
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _lseek for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, long, _lseek, (dmfsi_context_t ctx, void* fp, long offset, int whence) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_handle_t* handle = (romfs_handle_t*)fp;
+    long new_pos;
+    switch (whence) {
+        case DMFSI_SEEK_SET:
+            new_pos = offset;
+            break;
+        case DMFSI_SEEK_CUR:
+            new_pos = (long)handle->position + offset;
+            break;
+        case DMFSI_SEEK_END:
+            new_pos = (long)handle->entry->size + offset;
+            break;
+        default:
+            return DMFSI_ERR_INVALID;
+    }
+    if (new_pos < 0 || (unsigned long)new_pos > 0xFFFFFFFFu) {
+        return DMFSI_ERR_INVALID;
+    }
+    handle->position = (uint32_t)new_pos;
+    return new_pos;
+}
+
+// Implement _ioctl for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _ioctl, (dmfsi_context_t ctx, void* fp, int request, void* arg) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    switch (request) {
+        case ROMFS_IOCTL_GET_VIEW: {
+            romfs_handle_t* handle = (romfs_handle_t*)fp;
+            romfs_view_t* view = (romfs_view_t*)arg;
+            if (handle == NULL || handle->entry == NULL || view == NULL) {
+                return DMFSI_ERR_INVALID;
+            }
+            uint32_t file_size = handle->entry->size;
+            uint32_t position = (handle->position < file_size) ? handle->position : file_size;
+            view->data = handle->data + position;
+            view->size = file_size - position;
+            return DMFSI_OK;
+        }
+        default:
+            Dmod_Printf("RomFS: ioctl request %d not supported\n", request);
+            return DMFSI_ERR_GENERAL;
+    }
+}
+
+// Implement _sync for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _sync, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    return DMFSI_OK;
+}
+
+// Implement _getc for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _getc, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ROMFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_handle_t* handle = (romfs_handle_t*)fp;
+    if (handle->position >= handle->entry->size) {
+        return -1;
+    }
+    return handle->data[handle->position++];
+}
+
+// Implement _putc for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _putc, (dmfsi_context_t ctx, void* fp, int c) )
+{
+    return -1;
+}
+
+// Implement _tell for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, long, _tell, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ROMFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    return (long)((romfs_handle_t*)fp)->position;
+}
+
+// Implement _eof for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _eof, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ROMFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    romfs_handle_t* handle = (romfs_handle_t*)fp;
+    return (handle->position >= handle->entry->size) ? 1 : 0;
+}
+
+// Implement _size for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, long, _size, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ROMFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    return (long)((romfs_handle_t*)fp)->entry->size;
+}
+
+// Implement _fflush for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fflush, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    return DMFSI_OK;
+}
+
+// Implement _error for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _error, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    return DMFSI_OK;
+}
+
+// Implement _opendir for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _opendir, (dmfsi_context_t ctx, void** dp, const char* path) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // The entries inside a directory are a contiguous range of the sorted index
+    char prefix[ROMFS_MAX_PATH];
+    int length = romfs_dir_prefix(path, prefix);
+    if (length < 0) {
+        return DMFSI_ERR_INVALID;
+    }
+    uint32_t first = romfs_lower_bound(ctx, prefix, (size_t)length, 0);
+    uint32_t end = romfs_lower_bound(ctx, prefix, (size_t)length, 1);
+    if (first == end && length > 1) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+
+    romfs_dir_t* dir = (romfs_dir_t*)Dmod_Malloc(sizeof(romfs_dir_t));
+    if (dir == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    dir->index = first;
+    dir->end = end;
+    dir->prefix_length = (uint32_t)length;
+    *dp = dir;
+    return DMFSI_OK;
+}
+
+// Implement _closedir for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _closedir, (dmfsi_context_t ctx, void* dp) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    Dmod_Free(dp);
+    return DMFSI_OK;
+}
+
+// Implement _readdir for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _readdir, (dmfsi_context_t ctx, void* dp, dmfsi_dir_entry_t* entry) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    romfs_dir_t* dir = (romfs_dir_t*)dp;
+    if (dir->index >= dir->end) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+
+    const romfs_image_entry_t* image_entry = &ctx->entries[dir->index];
+    const char* name = romfs_entry_name(ctx, image_entry);
+    if (name == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // Report the next component - a file, or a subdirectory for a deeper path
+    const char* child = name + dir->prefix_length;
+    size_t length = 0;
+    while (child[length] != '\0' && child[length] != '/') {
+        length++;
+    }
+    if (length > sizeof(entry->name) - 1) {
+        length = sizeof(entry->name) - 1;
+    }
+    romfs_memcpy(entry->name, child, length);
+    entry->name[length] = '\0';
+
+    if (child[length] == '/') {
+        // Skip the rest of the subdirectory
+        dir->index = romfs_lower_bound(ctx, name, dir->prefix_length + length + 1, 1);
+        entry->size = 0;
+        entry->attr = DMFSI_ATTR_DIRECTORY | DMFSI_ATTR_READONLY;
+        entry->time = 0;
+    } else {
+        dir->index++;
+        entry->size = image_entry->size;
+        entry->attr = image_entry->attr | DMFSI_ATTR_READONLY;
+        entry->time = image_entry->mtime;
+    }
+    return DMFSI_OK;
+}
+
+// Implement _stat for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _stat, (dmfsi_context_t ctx, const char* path, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    const romfs_image_entry_t* entry = romfs_find_entry(ctx, path);
+    if (entry == NULL) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    romfs_fill_stat(entry, stat);
+    return DMFSI_OK;
+}
+
+// Implement _fstat for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _fstat, (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || fp == NULL || stat == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    romfs_fill_stat(((romfs_handle_t*)fp)->entry, stat);
+    return DMFSI_OK;
+}
+
+// Implement _stat_many for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _stat_many, (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC || paths == NULL || stats == NULL || results == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        const romfs_image_entry_t* entry = romfs_find_entry(ctx, paths[i]);
+        results[i] = (entry != NULL) ? DMFSI_OK : DMFSI_ERR_NOT_FOUND;
+        if (entry != NULL) {
+            romfs_fill_stat(entry, &stats[i]);
+            found++;
+        }
+    }
+    return found;
+}
+
+// Implement _unlink for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _unlink, (dmfsi_context_t ctx, const char* path) )
+{
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _rename for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _rename, (dmfsi_context_t ctx, const char* oldpath, const char* newpath) )
+{
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _chmod for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _chmod, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _utime for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _utime, (dmfsi_context_t ctx, const char* path, uint32_t atime, uint32_t mtime) )
+{
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _mkdir for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _mkdir, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    return DMFSI_ERR_INVALID;
+}
+
+// Implement _direxists for RomFS
+dmod_dmfsi_dif_api_declaration( 1.0, romfs, int, _direxists, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != ROMFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    char prefix[ROMFS_MAX_PATH];
+    int length = romfs_dir_prefix(path, prefix);
+    if (length < 0) {
+        return 0;
+    }
+    uint32_t index = romfs_lower_bound(ctx, prefix, (size_t)length, 0);
+    if (index >= ctx->header->file_count) {
+        return 0;
+    }
+    const char* name = romfs_entry_name(ctx, &ctx->entries[index]);
+    return (name != NULL && romfs_compare(name, prefix, (size_t)length) == 0) ? 1 : 0;
+}
+
+int dmod_init(const Dmod_Config_t *Config)
+{
+    Dmod_Printf("RomFS module initialized\n");
+    return 0;
+}
+
+int dmod_deinit(void)
+{
+    Dmod_Printf("RomFS module deinitialized\n");
+    return 0;
+}
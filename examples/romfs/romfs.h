@@ -0,0 +1,31 @@
+#ifndef ROMFS_H
+#define ROMFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief RomFS - Read-only packed image file system
+ *
+ * Requests accepted by the _ioctl of RomFS.
+ */
+
+/**
+ * @brief Get a zero-copy view of an opened file, arg is romfs_view_t*
+ *
+ * The view starts at the current position of the handle and covers the rest
+ * of the file. The position is not changed.
+ */
+#define ROMFS_IOCTL_GET_VIEW    0x5201
+
+/**
+ * @brief Zero-copy view of file data inside the image
+ *
+ * The data stays valid as long as the file system is mounted.
+ */
+typedef struct {
+    const void* data;           // First byte of the view
+    size_t size;                // Number of bytes in the view
+} romfs_view_t;
+
+#endif // ROMFS_H
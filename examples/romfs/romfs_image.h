@@ -0,0 +1,50 @@
+#ifndef ROMFS_IMAGE_H
+#define ROMFS_IMAGE_H
+
+#include <stdint.h>
+
+/**
+ * @brief RomFS image format
+ *
+ * Shared by the RomFS module and the host-side mkromfs tool. All fields are
+ * little-endian and 4-byte aligned, so the image can be used in place from
+ * memory on the target:
+ *
+ *  +----------------+  offset 0
+ *  | header         |
+ *  +----------------+  index_offset
+ *  | entries        |  file_count entries sorted by name (byte order)
+ *  +----------------+  names_offset
+ *  | names          |  NUL-terminated absolute paths, e.g. "/www/index.html"
+ *  +----------------+
+ *  | data           |  each file starts at a multiple of data_align
+ *  +----------------+  image_size
+ *
+ * Directories are not stored - they are implied by the paths of the files.
+ */
+
+#define ROMFS_IMAGE_MAGIC       0x494D4F52  // "ROMI" in hex
+#define ROMFS_IMAGE_VERSION     1
+
+typedef struct {
+    uint32_t magic;             // ROMFS_IMAGE_MAGIC
+    uint16_t version;           // ROMFS_IMAGE_VERSION
+    uint16_t header_size;       // sizeof(romfs_image_header_t)
+    uint32_t file_count;        // Number of entries in the index
+    uint32_t index_offset;      // Offset of the first entry
+    uint32_t names_offset;      // Offset of the names area
+    uint32_t data_align;        // Alignment of the file data (power of two)
+    uint32_t image_size;        // Size of the whole image
+    uint32_t reserved;
+} romfs_image_header_t;
+
+typedef struct {
+    uint32_t name_offset;       // Offset of the NUL-terminated path
+    uint16_t name_length;       // Length of the path without the NUL
+    uint16_t attr;              // File attributes (DMFSI_ATTR_*)
+    uint32_t data_offset;       // Offset of the file data
+    uint32_t size;              // Size of the file data
+    uint32_t mtime;             // Modification time of the source file
+} romfs_image_entry_t;
+
+#endif // ROMFS_IMAGE_H
@@ -0,0 +1,222 @@
+/**
+ * @brief mkromfs - build a RomFS image from a host directory
+ *
+ * Usage: mkromfs [-a align] <input directory> <output image>
+ *
+ * Every regular file below the input directory is stored with its path
+ * relative to it, e.g. `www/index.html` becomes `/index.html` when `www` is
+ * the input directory. The file data is aligned to `align` bytes (16 by
+ * default). See romfs_image.h for the format.
+ *
+ * Build on the host with:  cc -O2 -I.. -o mkromfs mkromfs.c
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "romfs_image.h"
+
+#define MKROMFS_MAX_PATH    4096
+
+typedef struct {
+    char* name;                 // Path inside the image
+    char* source;               // Path on the host
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t name_offset;
+    uint32_t data_offset;
+} mkromfs_file_t;
+
+static mkromfs_file_t* files = NULL;
+static size_t file_count = 0;
+static size_t file_capacity = 0;
+
+static void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+static int add_file(const char* name, const char* source, const struct stat* st)
+{
+    if (st->st_size > 0xFFFFFFFFLL || strlen(name) > 0xFFFF) {
+        fprintf(stderr, "mkromfs: '%s' is too large\n", source);
+        return -1;
+    }
+    if (file_count == file_capacity) {
+        file_capacity = file_capacity ? file_capacity * 2 : 64;
+        files = realloc(files, file_capacity * sizeof(mkromfs_file_t));
+        if (files == NULL) {
+            fprintf(stderr, "mkromfs: out of memory\n");
+            return -1;
+        }
+    }
+    mkromfs_file_t* file = &files[file_count++];
+    file->name = strdup(name);
+    file->source = strdup(source);
+    file->size = (uint32_t)st->st_size;
+    file->mtime = (uint32_t)st->st_mtime;
+    return (file->name != NULL && file->source != NULL) ? 0 : -1;
+}
+
+static int scan(const char* source, const char* name)
+{
+    DIR* dir = opendir(source);
+    if (dir == NULL) {
+        perror(source);
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent* de;
+    while (result == 0 && (de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+
+        char child_source[MKROMFS_MAX_PATH];
+        char child_name[MKROMFS_MAX_PATH];
+        struct stat st;
+        if (snprintf(child_source, sizeof(child_source), "%s/%s", source, de->d_name) >= (int)sizeof(child_source)
+            || snprintf(child_name, sizeof(child_name), "%s/%s", name, de->d_name) >= (int)sizeof(child_name)) {
+            fprintf(stderr, "mkromfs: path too long in '%s'\n", source);
+            result = -1;
+        } else if (stat(child_source, &st) != 0) {
+            perror(child_source);
+            result = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            result = scan(child_source, child_name);
+        } else if (S_ISREG(st.st_mode)) {
+            result = add_file(child_name, child_source, &st);
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+// Byte order of the names, the same as the lookups on the target
+static int compare_files(const void* a, const void* b)
+{
+    return strcmp(((const mkromfs_file_t*)a)->name, ((const mkromfs_file_t*)b)->name);
+}
+
+static int read_file(const mkromfs_file_t* file, uint8_t* dest)
+{
+    FILE* f = fopen(file->source, "rb");
+    if (f == NULL) {
+        perror(file->source);
+        return -1;
+    }
+    size_t read = fread(dest, 1, file->size, f);
+    fclose(f);
+    if (read != file->size) {
+        fprintf(stderr, "mkromfs: '%s' changed while reading\n", file->source);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t align = 16;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-a") == 0) {
+        align = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+        arg += 2;
+    }
+    if (argc - arg != 2 || align < 4 || (align & (align - 1)) != 0) {
+        fprintf(stderr, "Usage: %s [-a align] <input directory> <output image>\n", argv[0]);
+        fprintf(stderr, "       align must be a power of two, at least 4\n");
+        return 1;
+    }
+    const char* input = argv[arg];
+    const char* output = argv[arg + 1];
+
+    if (scan(input, "") != 0) {
+        return 1;
+    }
+    if (file_count > 0) {
+        qsort(files, file_count, sizeof(mkromfs_file_t), compare_files);
+    }
+
+    // Layout: header, index, names, aligned data
+    uint64_t offset = sizeof(romfs_image_header_t);
+    uint32_t index_offset = (uint32_t)offset;
+    offset += (uint64_t)file_count * sizeof(romfs_image_entry_t);
+    uint32_t names_offset = (uint32_t)offset;
+    for (size_t i = 0; i < file_count; i++) {
+        files[i].name_offset = (uint32_t)offset;
+        offset += strlen(files[i].name) + 1;
+    }
+    for (size_t i = 0; i < file_count; i++) {
+        offset = align_up((uint32_t)offset, align);
+        files[i].data_offset = (uint32_t)offset;
+        offset += files[i].size;
+        if (offset > 0xFFFFFFFFu - align) {
+            fprintf(stderr, "mkromfs: image larger than 4 GiB\n");
+            return 1;
+        }
+    }
+    uint32_t image_size = align_up((uint32_t)offset, 4);
+
+    uint8_t* image = calloc(1, image_size);
+    if (image == NULL) {
+        fprintf(stderr, "mkromfs: out of memory\n");
+        return 1;
+    }
+
+    put_u32(image + 0, ROMFS_IMAGE_MAGIC);
+    put_u16(image + 4, ROMFS_IMAGE_VERSION);
+    put_u16(image + 6, sizeof(romfs_image_header_t));
+    put_u32(image + 8, (uint32_t)file_count);
+    put_u32(image + 12, index_offset);
+    put_u32(image + 16, names_offset);
+    put_u32(image + 20, align);
+    put_u32(image + 24, image_size);
+
+    for (size_t i = 0; i < file_count; i++) {
+        const mkromfs_file_t* file = &files[i];
+        uint8_t* entry = image + index_offset + i * sizeof(romfs_image_entry_t);
+        size_t name_length = strlen(file->name);
+        put_u32(entry + 0, file->name_offset);
+        put_u16(entry + 4, (uint16_t)name_length);
+        put_u16(entry + 6, 0);
+        put_u32(entry + 8, file->data_offset);
+        put_u32(entry + 12, file->size);
+        put_u32(entry + 16, file->mtime);
+        memcpy(image + file->name_offset, file->name, name_length + 1);
+        if (read_file(file, image + file->data_offset) != 0) {
+            return 1;
+        }
+    }
+
+    FILE* out = fopen(output, "wb");
+    if (out == NULL) {
+        perror(output);
+        return 1;
+    }
+    size_t written = fwrite(image, 1, image_size, out);
+    if (fclose(out) != 0 || written != image_size) {
+        fprintf(stderr, "mkromfs: failed to write '%s'\n", output);
+        return 1;
+    }
+
+    printf("mkromfs: %zu files, %u bytes, data aligned to %u bytes\n", file_count, image_size, align);
+    return 0;
+}
@@ -0,0 +1,649 @@
+/**
+ * @brief dmfsi_replay - replay a TraceFS trace against a DMFSI implementation
+ *
+ * Usage: dmfsi_replay [-i impl] [-c config] [-t] [-j threads] [-u] <trace>
+ *
+ *   -i impl     implementation to replay on: ramfs (default), flashfs, romfs
+ *   -c config   config string passed to its _init
+ *   -t          keep the original timing of the trace, otherwise full speed
+ *   -j threads  replay the trace in several threads at once (1 by default)
+ *   -u          do not serialize the calls of the threads, only for
+ *               implementations that are safe to call concurrently
+ *
+ * The trace keeps only the hashes of the paths, so every path gets a
+ * synthetic name, `/r<thread>_<hash>`. Every thread has its own names and
+ * handles. Files that the traced application opened but did not create are
+ * created before the replay, sized after the reads and seeks on them.
+ *
+ * At the end the latency distribution of every operation is printed, with
+ * the number of calls whose result differs from the traced one. _ioctl
+ * requests are not replayed, their arguments are not in the trace.
+ *
+ * Built with the examples in DMOD_SYSTEM mode, it links the implementations
+ * statically (see DMFSI_STATIC_OPS).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dmod.h"
+#include "dmfsi.h"
+#include "tracefs_trace.h"
+
+#define REPLAY_MAX_THREADS  64
+#define REPLAY_MAX_HANDLES  65536
+#define REPLAY_NAME_LENGTH  32
+
+DMFSI_DECLARE_STATIC_IMPL(ramfs)
+DMFSI_DECLARE_STATIC_IMPL(flashfs)
+DMFSI_DECLARE_STATIC_IMPL(romfs)
+
+typedef struct {
+    const char* name;
+    dmfsi_ops_t ops;
+} replay_impl_t;
+
+static const char* const op_names[TRACEFS_OP_COUNT] = {
+    [TRACEFS_OP_FOPEN] = "fopen",           [TRACEFS_OP_FCLOSE] = "fclose",
+    [TRACEFS_OP_FREAD] = "fread",           [TRACEFS_OP_FWRITE] = "fwrite",
+    [TRACEFS_OP_LSEEK] = "lseek",           [TRACEFS_OP_IOCTL] = "ioctl",
+    [TRACEFS_OP_SYNC] = "sync",             [TRACEFS_OP_GETC] = "getc",
+    [TRACEFS_OP_PUTC] = "putc",             [TRACEFS_OP_TELL] = "tell",
+    [TRACEFS_OP_EOF] = "eof",               [TRACEFS_OP_SIZE] = "size",
+    [TRACEFS_OP_FFLUSH] = "fflush",         [TRACEFS_OP_ERROR] = "error",
+    [TRACEFS_OP_OPENDIR] = "opendir",       [TRACEFS_OP_CLOSEDIR] = "closedir",
+    [TRACEFS_OP_READDIR] = "readdir",       [TRACEFS_OP_STAT] = "stat",
+    [TRACEFS_OP_FSTAT] = "fstat",           [TRACEFS_OP_STAT_MANY] = "stat_many",
+    [TRACEFS_OP_UNLINK] = "unlink",         [TRACEFS_OP_RENAME] = "rename",
+    [TRACEFS_OP_CHMOD] = "chmod",           [TRACEFS_OP_UTIME] = "utime",
+    [TRACEFS_OP_MKDIR] = "mkdir",           [TRACEFS_OP_DIREXISTS] = "direxists",
+    [TRACEFS_OP_WATCH_ADD] = "watch_add",   [TRACEFS_OP_WATCH_READ] = "watch_read",
+    [TRACEFS_OP_WATCH_REMOVE] = "watch_remove",
+    [TRACEFS_OP_WALK] = "walk",             [TRACEFS_OP_REMOVE_TREE] = "remove_tree",
+    [TRACEFS_OP_OPENDIR_FILTER] = "opendir_filter",
+};
+
+// Latencies of one operation, in nanoseconds
+typedef struct {
+    uint64_t* samples;
+    size_t count;
+    size_t capacity;
+    size_t mismatches;
+} replay_stats_t;
+
+// A path that has to exist before the replay
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    int directory;
+} replay_seed_t;
+
+typedef struct {
+    int index;
+    pthread_t thread;
+    void* handles[REPLAY_MAX_HANDLES];
+    replay_stats_t stats[TRACEFS_OP_COUNT];
+    uint8_t* buffer;
+    size_t buffer_size;
+} replay_thread_t;
+
+static dmfsi_ops_t ops;
+static dmfsi_context_t ctx;
+static const tracefs_record_t* records;
+static size_t record_count;
+static int timed;
+static int keep_timing;
+static int unlocked;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline)
+{
+    struct timespec ts = {
+        .tv_sec = (time_t)(deadline / 1000000000ull),
+        .tv_nsec = (long)(deadline % 1000000000ull),
+    };
+    // Sleep again after a signal, give up on any other error
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static void make_name(char* name, int thread, uint32_t hash)
+{
+    snprintf(name, REPLAY_NAME_LENGTH, "/r%d_%08x", thread, hash);
+}
+
+static void add_sample(replay_stats_t* stats, uint64_t ns, int mismatch)
+{
+    if (stats->count == stats->capacity) {
+        stats->capacity = stats->capacity ? stats->capacity * 2 : 1024;
+        stats->samples = realloc(stats->samples, stats->capacity * sizeof(uint64_t));
+        if (stats->samples == NULL) {
+            fprintf(stderr, "dmfsi_replay: out of memory\n");
+            exit(1);
+        }
+    }
+    stats->samples[stats->count++] = ns;
+    stats->mismatches += mismatch ? 1 : 0;
+}
+
+static uint8_t* scratch(replay_thread_t* thread, size_t size)
+{
+    if (size > thread->buffer_size) {
+        thread->buffer = realloc(thread->buffer, size);
+        thread->buffer_size = size;
+        if (thread->buffer == NULL) {
+            fprintf(stderr, "dmfsi_replay: out of memory\n");
+            exit(1);
+        }
+        memset(thread->buffer, 'r', size);
+    }
+    return thread->buffer;
+}
+
+// Results match when both calls failed, or both succeeded with the same value
+static int mismatch(uint8_t op, long traced, long replayed)
+{
+    // The replayed files do not hold the traced data, _getc only has to read a byte where it did
+    if (op == TRACEFS_OP_GETC || traced < 0 || replayed < 0) {
+        return (traced < 0) != (replayed < 0);
+    }
+    return traced != replayed;
+}
+
+static int find_seed(const replay_seed_t* seeds, size_t count, uint32_t hash)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (seeds[i].hash == hash) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Looks the hash up in the paths seen so far, and adds it when it is new
+static int find_known(uint32_t* known, size_t* count, uint32_t hash)
+{
+    for (size_t i = 0; i < *count; i++) {
+        if (known[i] == hash) {
+            return 1;
+        }
+    }
+    known[(*count)++] = hash;
+    return 0;
+}
+
+/**
+ * Finds the paths that existed before the trace: the first call on them
+ * succeeded without creating them. A file gets the size that its reads and
+ * seeks reached.
+ */
+static size_t find_seeds(replay_seed_t** result)
+{
+    size_t count = 0;
+    size_t capacity = 64;
+    replay_seed_t* seeds = malloc(capacity * sizeof(replay_seed_t));
+    uint32_t* known = calloc(2 * record_count + 1, sizeof(uint32_t));
+    size_t known_count = 0;
+    static uint32_t handle_path[REPLAY_MAX_HANDLES];
+    static uint32_t handle_position[REPLAY_MAX_HANDLES];
+
+    for (size_t i = 0; i < record_count; i++) {
+        const tracefs_record_t* r = &records[i];
+        uint32_t hash = r->path;
+        if (hash != 0 && !find_known(known, &known_count, hash)) {
+            int creates = (r->op == TRACEFS_OP_MKDIR)
+                          || (r->op == TRACEFS_OP_FOPEN && (r->arg0 & DMFSI_O_CREAT))
+                          || (r->op == TRACEFS_OP_WATCH_ADD);
+            if (r->result >= 0 && !creates && r->op != TRACEFS_OP_PATH) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    seeds = realloc(seeds, capacity * sizeof(replay_seed_t));
+                }
+                seeds[count].hash = hash;
+                seeds[count].size = 0;
+                seeds[count].directory = (r->op == TRACEFS_OP_OPENDIR || r->op == TRACEFS_OP_OPENDIR_FILTER
+                                          || r->op == TRACEFS_OP_DIREXISTS
+                                          || r->op == TRACEFS_OP_WALK || r->op == TRACEFS_OP_REMOVE_TREE);
+                count++;
+            }
+        }
+
+        // The new path of a rename is created by it
+        if (r->op == TRACEFS_OP_RENAME && r->result >= 0) {
+            find_known(known, &known_count, r->arg0);
+        }
+
+        // Extents reached through the handles of the seeded files
+        if (r->op == TRACEFS_OP_FOPEN && r->result >= 0) {
+            handle_path[r->handle] = hash;
+            handle_position[r->handle] = 0;
+        } else if (r->handle != 0 && handle_path[r->handle] != 0) {
+            uint32_t* position = &handle_position[r->handle];
+            if (r->op == TRACEFS_OP_FREAD || r->op == TRACEFS_OP_FWRITE) {
+                *position += r->arg1;
+            } else if (r->op == TRACEFS_OP_GETC && r->result >= 0) {
+                *position += 1;
+            } else if (r->op == TRACEFS_OP_LSEEK && r->result >= 0 && r->arg1 <= DMFSI_SEEK_END) {
+                *position = (uint32_t)r->result;
+            } else if (r->op == TRACEFS_OP_SIZE && r->result > 0 && (uint32_t)r->result > *position) {
+                *position = (uint32_t)r->result;
+            }
+            int seed = find_seed(seeds, count, handle_path[r->handle]);
+            if (seed >= 0 && r->op != TRACEFS_OP_FWRITE && *position > seeds[seed].size) {
+                seeds[seed].size = *position;
+            }
+            if (r->op == TRACEFS_OP_FCLOSE) {
+                handle_path[r->handle] = 0;
+            }
+        }
+    }
+
+    free(known);
+    *result = seeds;
+    return count;
+}
+
+static int create_seeds(int thread, const replay_seed_t* seeds, size_t count)
+{
+    char name[REPLAY_NAME_LENGTH];
+    uint8_t block[4096];
+    memset(block, 's', sizeof(block));
+
+    for (size_t i = 0; i < count; i++) {
+        make_name(name, thread, seeds[i].hash);
+        if (seeds[i].directory) {
+            if (ops.mkdir == NULL || ops.mkdir(ctx, name, 0755) != DMFSI_OK) {
+                fprintf(stderr, "dmfsi_replay: cannot create directory '%s'\n", name);
+                return -1;
+            }
+            continue;
+        }
+
+        void* fp = NULL;
+        if (ops.fopen(ctx, &fp, name, DMFSI_O_WRONLY | DMFSI_O_CREAT | DMFSI_O_TRUNC, 0) != DMFSI_OK) {
+            fprintf(stderr, "dmfsi_replay: cannot create file '%s'\n", name);
+            return -1;
+        }
+        uint32_t left = seeds[i].size;
+        while (left > 0) {
+            size_t chunk = left < sizeof(block) ? left : sizeof(block);
+            size_t written = 0;
+            if (ops.fwrite(ctx, fp, block, chunk, &written) != DMFSI_OK || written == 0) {
+                break;
+            }
+            left -= (uint32_t)written;
+        }
+        ops.fclose(ctx, fp);
+    }
+    return 0;
+}
+
+static int walk_entry(void* arg, const char* path, const dmfsi_stat_t* stat)
+{
+    return 0;
+}
+
+// Replays one record, returns the result of the call or 1 when it is not replayed
+static long replay(replay_thread_t* thread, const tracefs_record_t* r, const char* const* paths, size_t path_count)
+{
+    char name[REPLAY_NAME_LENGTH];
+    char other[REPLAY_NAME_LENGTH];
+    void** handle = &thread->handles[r->handle];
+    size_t done = 0;
+    long result = 0;
+
+    make_name(name, thread->index, r->path);
+    switch (r->op) {
+        case TRACEFS_OP_FOPEN:
+            result = ops.fopen(ctx, handle, name, (int)r->arg0, (int)r->arg1);
+            break;
+        case TRACEFS_OP_FCLOSE:
+            result = ops.fclose(ctx, *handle);
+            *handle = NULL;
+            break;
+        case TRACEFS_OP_FREAD:
+            result = ops.fread(ctx, *handle, scratch(thread, r->arg0), r->arg0, &done);
+            return (result == DMFSI_OK && done != r->arg1) ? -1 - (long)done : result;
+        case TRACEFS_OP_FWRITE:
+            result = ops.fwrite(ctx, *handle, scratch(thread, r->arg0), r->arg0, &done);
+            return (result == DMFSI_OK && done != r->arg1) ? -1 - (long)done : result;
+        case TRACEFS_OP_LSEEK:
+            result = ops.lseek ? ops.lseek(ctx, *handle, (long)(int32_t)r->arg0, (int)r->arg1) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_SYNC:
+            result = ops.sync ? ops.sync(ctx, r->handle ? *handle : NULL) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_GETC:
+            result = ops.getc ? ops.getc(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_PUTC:
+            result = ops.putc ? ops.putc(ctx, *handle, (int)r->arg0) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_TELL:
+            result = ops.tell ? ops.tell(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_EOF:
+            result = ops.eof ? ops.eof(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_SIZE:
+            result = ops.size ? ops.size(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_FFLUSH:
+            result = ops.fflush ? ops.fflush(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_ERROR:
+            result = ops.error ? ops.error(ctx, *handle) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_OPENDIR:
+            result = ops.opendir ? ops.opendir(ctx, handle, r->path ? name : "/") : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_OPENDIR_FILTER: {
+            // The patterns are not in the trace, only the attribute test
+            dmfsi_dir_filter_t filter = { NULL, NULL, r->arg0, r->arg1 };
+            result = ops.opendir_filter ? ops.opendir_filter(ctx, handle, r->path ? name : "/", &filter) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_CLOSEDIR:
+            result = ops.closedir ? ops.closedir(ctx, *handle) : DMFSI_ERR_GENERAL;
+            *handle = NULL;
+            break;
+        case TRACEFS_OP_READDIR: {
+            dmfsi_dir_entry_t entry;
+            result = ops.readdir ? ops.readdir(ctx, *handle, &entry) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_STAT: {
+            dmfsi_stat_t stat;
+            result = ops.stat ? ops.stat(ctx, name, &stat) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_FSTAT: {
+            dmfsi_stat_t stat;
+            result = ops.fstat ? ops.fstat(ctx, *handle, &stat) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_STAT_MANY: {
+            dmfsi_stat_t* stats = (dmfsi_stat_t*)scratch(thread, path_count * (sizeof(dmfsi_stat_t) + sizeof(int)));
+            int* results = (int*)(stats + path_count);
+            result = ops.stat_many ? ops.stat_many(ctx, paths, path_count, stats, results) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_UNLINK:
+            result = ops.unlink ? ops.unlink(ctx, name) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_RENAME:
+            make_name(other, thread->index, r->arg0);
+            result = ops.rename ? ops.rename(ctx, name, other) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_CHMOD:
+            result = ops.chmod ? ops.chmod(ctx, name, (int)r->arg0) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_UTIME:
+            result = ops.utime ? ops.utime(ctx, name, r->arg0, r->arg1) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_MKDIR:
+            result = ops.mkdir ? ops.mkdir(ctx, name, (int)r->arg0) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_DIREXISTS:
+            result = ops.direxists ? ops.direxists(ctx, r->path ? name : "/") : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_WATCH_ADD:
+            result = ops.watch_add ? ops.watch_add(ctx, handle, name, r->arg0, r->arg1) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_WATCH_READ: {
+            dmfsi_event_t* events = (dmfsi_event_t*)scratch(thread, r->arg0 * sizeof(dmfsi_event_t));
+            result = ops.watch_read ? ops.watch_read(ctx, *handle, events, r->arg0) : DMFSI_ERR_GENERAL;
+            break;
+        }
+        case TRACEFS_OP_WATCH_REMOVE:
+            result = ops.watch_remove ? ops.watch_remove(ctx, *handle) : DMFSI_ERR_GENERAL;
+            *handle = NULL;
+            break;
+        case TRACEFS_OP_WALK:
+            result = ops.walk ? ops.walk(ctx, name, walk_entry, NULL) : DMFSI_ERR_GENERAL;
+            break;
+        case TRACEFS_OP_REMOVE_TREE:
+            result = ops.remove_tree ? ops.remove_tree(ctx, name) : DMFSI_ERR_GENERAL;
+            break;
+        default:
+            return 1;
+    }
+    return result;
+}
+
+static void* replay_thread(void* arg)
+{
+    replay_thread_t* thread = (replay_thread_t*)arg;
+    char (*names)[REPLAY_NAME_LENGTH] = NULL;
+    const char** paths = NULL;
+    size_t path_count = 0;
+    size_t path_capacity = 0;
+    uint64_t schedule = now_ns();
+
+    for (size_t i = 0; i < record_count; i++) {
+        const tracefs_record_t* r = &records[i];
+        if (r->op == 0 || r->op >= TRACEFS_OP_COUNT || r->op == TRACEFS_OP_IOCTL) {
+            continue;
+        }
+        if (r->op == TRACEFS_OP_PATH) {
+            if (path_count == path_capacity) {
+                path_capacity = path_capacity ? path_capacity * 2 : 16;
+                names = realloc(names, path_capacity * REPLAY_NAME_LENGTH);
+                paths = realloc(paths, path_capacity * sizeof(char*));
+            }
+            make_name(names[path_count], thread->index, r->path);
+            path_count++;
+            continue;
+        }
+        for (size_t k = 0; k < path_count; k++) {
+            paths[k] = names[k];
+        }
+        if (timed && keep_timing) {
+            schedule += (uint64_t)r->delta_us * 1000ull;
+            sleep_until(schedule);
+        }
+
+        if (!unlocked) {
+            pthread_mutex_lock(&lock);
+        }
+        uint64_t start = now_ns();
+        long result = replay(thread, r, paths, path_count);
+        uint64_t end = now_ns();
+        if (!unlocked) {
+            pthread_mutex_unlock(&lock);
+        }
+
+        if (r->op == TRACEFS_OP_STAT_MANY) {
+            path_count = 0;
+        }
+        add_sample(&thread->stats[r->op], end - start, mismatch(r->op, r->result, result));
+    }
+
+    free(names);
+    free(paths);
+    return NULL;
+}
+
+static int compare_samples(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const replay_stats_t* stats, double p)
+{
+    size_t index = (size_t)(p * (double)(stats->count - 1) + 0.5);
+    return (double)stats->samples[index] / 1000.0;
+}
+
+static void report(replay_thread_t* threads, int thread_count, double seconds)
+{
+    fprintf(stderr, "%-13s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+            "op", "count", "mean us", "p50", "p90", "p99", "p99.9", "max", "mismatch");
+
+    size_t total = 0;
+    for (int op = 1; op < TRACEFS_OP_COUNT; op++) {
+        replay_stats_t all = { 0 };
+        for (int t = 0; t < thread_count; t++) {
+            const replay_stats_t* stats = &threads[t].stats[op];
+            for (size_t k = 0; k < stats->count; k++) {
+                add_sample(&all, stats->samples[k], 0);
+            }
+            all.mismatches += stats->mismatches;
+        }
+        if (all.count == 0) {
+            continue;
+        }
+
+        qsort(all.samples, all.count, sizeof(uint64_t), compare_samples);
+        uint64_t sum = 0;
+        for (size_t k = 0; k < all.count; k++) {
+            sum += all.samples[k];
+        }
+        fprintf(stderr, "%-13s %9zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9zu\n",
+                op_names[op], all.count, (double)sum / (double)all.count / 1000.0,
+                percentile(&all, 0.5), percentile(&all, 0.9), percentile(&all, 0.99),
+                percentile(&all, 0.999), (double)all.samples[all.count - 1] / 1000.0, all.mismatches);
+        total += all.count;
+        free(all.samples);
+    }
+    fprintf(stderr, "%zu calls in %.3f s, %.0f calls/s\n", total, seconds, (double)total / seconds);
+}
+
+static int load_trace(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    tracefs_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != TRACEFS_TRACE_MAGIC
+        || header.version != TRACEFS_TRACE_VERSION || header.record_size != sizeof(tracefs_record_t)) {
+        fprintf(stderr, "dmfsi_replay: '%s' is not a TraceFS trace\n", path);
+        fclose(f);
+        return -1;
+    }
+    timed = (header.flags & TRACEFS_TRACE_TIMED) != 0;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f) - header.header_size;
+    fseek(f, header.header_size, SEEK_SET);
+    record_count = size > 0 ? (size_t)size / sizeof(tracefs_record_t) : 0;
+    tracefs_record_t* buffer = malloc(record_count * sizeof(tracefs_record_t) + 1);
+    if (buffer == NULL || fread(buffer, sizeof(tracefs_record_t), record_count, f) != record_count) {
+        fprintf(stderr, "dmfsi_replay: cannot read '%s'\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    records = buffer;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const replay_impl_t impls[] = {
+        { "ramfs",   DMFSI_STATIC_OPS(ramfs) },
+        { "flashfs", DMFSI_STATIC_OPS(flashfs) },
+        { "romfs",   DMFSI_STATIC_OPS(romfs) },
+    };
+    const char* impl = "ramfs";
+    const char* config = NULL;
+    int thread_count = 1;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-i") == 0 && arg + 1 < argc) {
+            impl = argv[++arg];
+        } else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc) {
+            config = argv[++arg];
+        } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            thread_count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-t") == 0) {
+            keep_timing = 1;
+        } else if (strcmp(argv[arg], "-u") == 0) {
+            unlocked = 1;
+        } else {
+            arg = argc;     // Unknown option, print the usage
+            break;
+        }
+    }
+    if (argc - arg != 1 || thread_count < 1 || thread_count > REPLAY_MAX_THREADS) {
+        fprintf(stderr, "Usage: %s [-i impl] [-c config] [-t] [-j threads] [-u] <trace>\n", argv[0]);
+        fprintf(stderr, "       impl is ramfs, flashfs or romfs, threads is 1 to %d\n", REPLAY_MAX_THREADS);
+        return 1;
+    }
+
+    size_t i = 0;
+    while (i < sizeof(impls) / sizeof(impls[0]) && strcmp(impls[i].name, impl) != 0) {
+        i++;
+    }
+    if (i == sizeof(impls) / sizeof(impls[0])) {
+        fprintf(stderr, "dmfsi_replay: unknown implementation '%s'\n", impl);
+        return 1;
+    }
+    ops = impls[i].ops;
+
+    if (load_trace(argv[arg]) != 0) {
+        return 1;
+    }
+    if (keep_timing && !timed) {
+        fprintf(stderr, "dmfsi_replay: the trace has no timing, replaying at full speed\n");
+    }
+
+    ctx = ops.init(config);
+    if (ctx == NULL) {
+        fprintf(stderr, "dmfsi_replay: cannot initialize '%s'\n", impl);
+        return 1;
+    }
+
+    replay_seed_t* seeds = NULL;
+    size_t seed_count = find_seeds(&seeds);
+    replay_thread_t* threads = calloc((size_t)thread_count, sizeof(replay_thread_t));
+    for (int t = 0; t < thread_count; t++) {
+        threads[t].index = t;
+        if (create_seeds(t, seeds, seed_count) != 0) {
+            return 1;
+        }
+    }
+
+    uint64_t start = now_ns();
+    for (int t = 0; t < thread_count; t++) {
+        pthread_create(&threads[t].thread, NULL, replay_thread, &threads[t]);
+    }
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t].thread, NULL);
+    }
+    double seconds = (double)(now_ns() - start) / 1e9;
+
+    fprintf(stderr, "dmfsi_replay: %zu records on %s, %d thread(s), %zu file(s) created first\n",
+            record_count, impl, thread_count, seed_count);
+    report(threads, thread_count, seconds);
+
+    ops.deinit(ctx);
+    for (int t = 0; t < thread_count; t++) {
+        for (int op = 0; op < TRACEFS_OP_COUNT; op++) {
+            free(threads[t].stats[op].samples);
+        }
+        free(threads[t].buffer);
+    }
+    free(threads);
+    free(seeds);
+    free((void*)records);
+    return 0;
+}
@@ -0,0 +1,1020 @@
+#define DMOD_ENABLE_REGISTRATION    ON
+#ifndef DMOD_tracefs
+#   define DMOD_tracefs
+#endif
+
+#include "dmod.h"
+#include "dmfsi.h"
+#include "tracefs.h"
+#include "tracefs_trace.h"
+
+/**
+ * @brief TraceFS - Recording shim for DMFSI implementations
+ *
+ * Example implementation of the DMFSI interface that passes every call to
+ * another implementation and records it in a binary trace file (see
+ * tracefs_trace.h). The trace can be replayed against any implementation
+ * with the host-side tool (tools/dmfsi_replay.c), so the workload of a
+ * device can be used to benchmark file systems offline.
+ *
+ * Example config string:
+ *
+ *      trace=/tmp/app.trace;buffer=256;target=ramfs;target_config=<config of ramfs>
+ *
+ * target_config must be the last option, it takes the rest of the string.
+ * `buffer` is the number of records kept in RAM between writes to the trace
+ * file (128 by default). The records get timestamps once a clock is set
+ * with TRACEFS_IOCTL_SET_CLOCK.
+ */
+
+#define TRACEFS_CONTEXT_MAGIC   0x54524346  // "TRCF" in hex
+#define TRACEFS_DEFAULT_BUFFER  128
+#define TRACEFS_MAX_PATH        256
+
+// Context check of operations on an opened handle (see DMFSI_VALIDATE_HOT_PATH)
+#if DMFSI_VALIDATE_HOT_PATH
+#   define TRACEFS_HOT_PATH_CTX_IS_VALID(ctx)  ((ctx) != NULL && (ctx)->magic == TRACEFS_CONTEXT_MAGIC)
+#else
+#   define TRACEFS_HOT_PATH_CTX_IS_VALID(ctx)  1
+#endif
+
+// Handle of a file, directory or watch of the traced implementation
+typedef struct {
+    void* target;
+    uint16_t id;
+    uint32_t path;              // Directories: hash of the path and a '/', to hash the names in it
+} tracefs_handle_t;
+
+// Context structure definition
+struct dmfsi_context {
+    uint32_t magic;
+    dmfsi_ops_t target;                 // Operations of the traced implementation
+    dmfsi_context_t target_ctx;
+    void* trace;                        // Trace file
+    void* lock;                         // Serializes the records of concurrent calls
+    tracefs_clock_t clock;              // NULL - records without timing
+    uint32_t last_start;                // Start of the previous record
+    uint16_t next_id;                   // Id of the next handle
+    uint32_t record_count;              // Records waiting in the buffer
+    uint32_t buffer_length;
+    tracefs_record_t buffer[];
+};
+
+// Helper function to find the value of an option in a `key=value;` config string
+static const char* tracefs_config_find(const char* config, const char* key)
+{
+    const char* p = config;
+    while (p != NULL && *p) {
+        const char* k = key;
+        const char* v = p;
+        while (*k && *v == *k) {
+            k++;
+            v++;
+        }
+        if (*k == '\0' && *v == '=') {
+            return v + 1;
+        }
+        while (*p && *p != ';') {
+            p++;
+        }
+        if (*p == ';') {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+// Helper function to copy a string option, returns 0 if it is not set
+static int tracefs_config_string(const char* config, const char* key, char* buffer, size_t size)
+{
+    const char* v = tracefs_config_find(config, key);
+    if (v == NULL) {
+        return 0;
+    }
+    size_t len = 0;
+    while (v[len] && v[len] != ';' && len < size - 1) {
+        buffer[len] = v[len];
+        len++;
+    }
+    buffer[len] = '\0';
+    return len > 0;
+}
+
+// Helper function to parse a decimal option
+static uint32_t tracefs_config_number(const char* config, const char* key, uint32_t def)
+{
+    const char* v = tracefs_config_find(config, key);
+    if (v == NULL || *v < '0' || *v > '9') {
+        return def;
+    }
+    uint32_t value = 0;
+    while (*v >= '0' && *v <= '9') {
+        value = value * 10 + (uint32_t)(*v - '0');
+        v++;
+    }
+    return value;
+}
+
+// FNV-1a hash of a path, continued from the hash of the part before @p s
+static uint32_t tracefs_hash_from(uint32_t hash, const char* s)
+{
+    while (*s) {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a hash of a path, the trace does not keep the names
+static uint32_t tracefs_hash(const char* s)
+{
+    return (s != NULL) ? tracefs_hash_from(2166136261u, s) : 0;
+}
+
+// Hash of a directory path followed by a single '/', the start of the paths of its files
+static uint32_t tracefs_hash_dir(const char* path)
+{
+    size_t length = 0;
+    while (path[length] != '\0') {
+        length++;
+    }
+    while (length > 0 && path[length - 1] == '/') {
+        length--;
+    }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+    hash ^= (unsigned char)'/';
+    return hash * 16777619u;
+}
+
+// Hash of the full path of a name relative to a directory handle
+static uint32_t tracefs_hash_at(const tracefs_handle_t* dir, const char* name)
+{
+    if (name == NULL || name[0] == '/' || dir == NULL) {
+        return tracefs_hash(name);
+    }
+    return tracefs_hash_from(dir->path, name);
+}
+
+static inline uint32_t tracefs_now(dmfsi_context_t ctx)
+{
+    return (ctx->clock != NULL) ? ctx->clock() : 0;
+}
+
+// Helper function to write the buffered records to the trace file
+static int tracefs_flush(dmfsi_context_t ctx)
+{
+    if (ctx->record_count == 0) {
+        return DMFSI_OK;
+    }
+    size_t written = Dmod_FileWrite(ctx->buffer, sizeof(tracefs_record_t), ctx->record_count, ctx->trace);
+    int result = (written == ctx->record_count) ? DMFSI_OK : DMFSI_ERR_NO_SPACE;
+    if (result != DMFSI_OK) {
+        Dmod_Printf("TraceFS: Lost %u records\n", (unsigned)(ctx->record_count - written));
+    }
+    ctx->record_count = 0;
+    return result;
+}
+
+// Helper function to fill the next record of the buffer, called with the lock taken
+static void tracefs_append(dmfsi_context_t ctx, uint8_t op, uint16_t handle, long result,
+                           uint32_t path, uint32_t arg0, uint32_t arg1, uint32_t delta, uint32_t duration)
+{
+    tracefs_record_t* record = &ctx->buffer[ctx->record_count++];
+    record->op = op;
+    record->reserved = 0;
+    record->handle = handle;
+    record->result = (int32_t)result;
+    record->path = path;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    record->delta_us = delta;
+    record->duration_us = duration;
+    if (ctx->record_count == ctx->buffer_length) {
+        tracefs_flush(ctx);
+    }
+}
+
+/**
+ * Helper function to add the record of a finished call. The records of
+ * @p paths (for calls with several paths) are written right before it.
+ */
+static void tracefs_record_paths(dmfsi_context_t ctx, uint8_t op, uint16_t handle, long result,
+                                 uint32_t path, uint32_t arg0, uint32_t arg1, uint32_t start,
+                                 const char* const* paths, size_t path_count)
+{
+    uint32_t end = tracefs_now(ctx);
+
+    if (ctx->lock != NULL) {
+        Dmod_Mutex_Lock(ctx->lock);
+    }
+
+    for (size_t i = 0; i < path_count; i++) {
+        tracefs_append(ctx, TRACEFS_OP_PATH, 0, 0, tracefs_hash(paths[i]), 0, 0, 0, 0);
+    }
+
+    // Concurrent calls are recorded as they finish, so a call can start before the previous one
+    int32_t delta = (int32_t)(start - ctx->last_start);
+    if (delta > 0) {
+        ctx->last_start = start;
+    }
+    tracefs_append(ctx, op, handle, result, path, arg0, arg1, (delta > 0) ? (uint32_t)delta : 0, end - start);
+
+    if (ctx->lock != NULL) {
+        Dmod_Mutex_Unlock(ctx->lock);
+    }
+}
+
+static inline void tracefs_record(dmfsi_context_t ctx, uint8_t op, uint16_t handle, long result,
+                                  uint32_t path, uint32_t arg0, uint32_t arg1, uint32_t start)
+{
+    tracefs_record_paths(ctx, op, handle, result, path, arg0, arg1, start, NULL, 0);
+}
+
+// Helper function to wrap a handle of the traced implementation
+static tracefs_handle_t* tracefs_handle_new(dmfsi_context_t ctx, void* target)
+{
+    tracefs_handle_t* handle = (tracefs_handle_t*)Dmod_Malloc(sizeof(tracefs_handle_t));
+    if (handle == NULL) {
+        return NULL;
+    }
+    handle->target = target;
+    handle->path = 0;
+
+    if (ctx->lock != NULL) {
+        Dmod_Mutex_Lock(ctx->lock);
+    }
+    if (++ctx->next_id == 0) {
+        ctx->next_id = 1;
+    }
+    handle->id = ctx->next_id;
+    if (ctx->lock != NULL) {
+        Dmod_Mutex_Unlock(ctx->lock);
+    }
+    return handle;
+}
+
+// Implement _init for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, dmfsi_context_t, _init, (const char* config) )
+{
+    Dmod_Printf("TraceFS: Initializing file system\n");
+
+    char target_name[32];
+    char trace_path[TRACEFS_MAX_PATH];
+    if (!tracefs_config_string(config, "target", target_name, sizeof(target_name))
+        || !tracefs_config_string(config, "trace", trace_path, sizeof(trace_path))) {
+        Dmod_Printf("TraceFS: 'target' and 'trace' options are required\n");
+        return NULL;
+    }
+
+    uint32_t buffer_length = tracefs_config_number(config, "buffer", TRACEFS_DEFAULT_BUFFER);
+    if (buffer_length == 0) {
+        buffer_length = 1;
+    }
+    struct dmfsi_context* ctx = (struct dmfsi_context*)Dmod_Malloc(
+        sizeof(struct dmfsi_context) + buffer_length * sizeof(tracefs_record_t));
+    if (ctx == NULL) {
+        Dmod_Printf("TraceFS: Failed to allocate context\n");
+        return NULL;
+    }
+
+    ctx->magic = TRACEFS_CONTEXT_MAGIC;
+    ctx->clock = NULL;
+    ctx->last_start = 0;
+    ctx->next_id = 0;
+    ctx->record_count = 0;
+    ctx->buffer_length = buffer_length;
+    ctx->lock = Dmod_Mutex_New(false);
+    ctx->trace = NULL;
+    ctx->target_ctx = NULL;
+
+    if (dmfsi_ops_resolve_by_name(target_name, &ctx->target) != DMFSI_OK) {
+        Dmod_Printf("TraceFS: Traced file system '%s' not available\n", target_name);
+    } else if ((ctx->trace = Dmod_FileOpen(trace_path, "wb")) == NULL) {
+        Dmod_Printf("TraceFS: Cannot create trace '%s'\n", trace_path);
+    } else {
+        ctx->target_ctx = ctx->target.init(tracefs_config_find(config, "target_config"));
+    }
+    if (ctx->target_ctx == NULL) {
+        if (ctx->trace != NULL) {
+            Dmod_FileClose(ctx->trace);
+        }
+        if (ctx->lock != NULL) {
+            Dmod_Mutex_Delete(ctx->lock);
+        }
+        Dmod_Free(ctx);
+        return NULL;
+    }
+
+    // The flags are rewritten when the trace is closed, a clock may be set later
+    tracefs_trace_header_t header = {
+        .magic = TRACEFS_TRACE_MAGIC,
+        .version = TRACEFS_TRACE_VERSION,
+        .header_size = sizeof(tracefs_trace_header_t),
+        .flags = 0,
+        .record_size = sizeof(tracefs_record_t),
+    };
+    Dmod_FileWrite(&header, sizeof(header), 1, ctx->trace);
+
+    Dmod_Printf("TraceFS: Tracing '%s' to '%s'\n", target_name, trace_path);
+    return ctx;
+}
+
+// Implement _deinit for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _deinit, (dmfsi_context_t ctx) )
+{
+    Dmod_Printf("TraceFS: Deinitializing file system\n");
+
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    int result = ctx->target.deinit(ctx->target_ctx);
+
+    tracefs_flush(ctx);
+    if (ctx->clock != NULL) {
+        tracefs_trace_header_t header = {
+            .magic = TRACEFS_TRACE_MAGIC,
+            .version = TRACEFS_TRACE_VERSION,
+            .header_size = sizeof(tracefs_trace_header_t),
+            .flags = TRACEFS_TRACE_TIMED,
+            .record_size = sizeof(tracefs_record_t),
+        };
+        Dmod_FileSeek(ctx->trace, 0, 0);
+        Dmod_FileWrite(&header, sizeof(header), 1, ctx->trace);
+    }
+    Dmod_FileClose(ctx->trace);
+
+    if (ctx->lock != NULL) {
+        Dmod_Mutex_Delete(ctx->lock);
+    }
+    ctx->magic = 0xDEADBEEF;
+    Dmod_Free(ctx);
+    return result;
+}
+
+// Implement _context_is_valid for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _context_is_valid, (dmfsi_context_t ctx) )
+{
+    if (ctx == NULL || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return 0;
+    }
+    return ctx->target.context_is_valid(ctx->target_ctx);
+}
+
+// Implement _fopen for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fopen, (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    void* target = NULL;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fopen(ctx->target_ctx, &target, path, mode, attr);
+    tracefs_handle_t* handle = NULL;
+    if (result == DMFSI_OK) {
+        handle = tracefs_handle_new(ctx, target);
+        if (handle == NULL) {
+            ctx->target.fclose(ctx->target_ctx, target);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        *fp = handle;
+    }
+    tracefs_record(ctx, TRACEFS_OP_FOPEN, handle ? handle->id : 0, result, tracefs_hash(path),
+                   (uint32_t)mode, (uint32_t)attr, start);
+    return result;
+}
+
+// Implement _fclose for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fclose, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fclose(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_FCLOSE, handle->id, result, 0, 0, 0, start);
+    Dmod_Free(handle);
+    return result;
+}
+
+// Implement _fread for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fread, (dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fread(ctx->target_ctx, handle->target, buffer, size, read);
+    // *read is only set by a successful call
+    uint32_t done = (result == DMFSI_OK) ? (uint32_t)*read : 0;
+    tracefs_record(ctx, TRACEFS_OP_FREAD, handle->id, result, 0, (uint32_t)size, done, start);
+    return result;
+}
+
+// Implement _fwrite for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fwrite, (dmfsi_context_t ctx, void* fp, const void* buffer, size_t size, size_t* written) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fwrite(ctx->target_ctx, handle->target, buffer, size, written);
+    // *written is only set by a successful call
+    uint32_t done = (result == DMFSI_OK) ? (uint32_t)*written : 0;
+    tracefs_record(ctx, TRACEFS_OP_FWRITE, handle->id, result, 0, (uint32_t)size, done, start);
+    return result;
+}
+
+// Implement _lseek for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, long, _lseek, (dmfsi_context_t ctx, void* fp, long offset, int whence) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.lseek == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    long result = ctx->target.lseek(ctx->target_ctx, handle->target, offset, whence);
+    tracefs_record(ctx, TRACEFS_OP_LSEEK, handle->id, result, 0, (uint32_t)offset, (uint32_t)whence, start);
+    return result;
+}
+
+// Implement _ioctl for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _ioctl, (dmfsi_context_t ctx, void* fp, int request, void* arg) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // Requests of TraceFS itself
+    if (fp == NULL && request == TRACEFS_IOCTL_SET_CLOCK) {
+        if (arg == NULL) {
+            return DMFSI_ERR_INVALID;
+        }
+        ctx->clock = *(tracefs_clock_t*)arg;
+        ctx->last_start = tracefs_now(ctx);
+        return DMFSI_OK;
+    }
+    if (fp == NULL && request == TRACEFS_IOCTL_FLUSH) {
+        if (ctx->lock != NULL) {
+            Dmod_Mutex_Lock(ctx->lock);
+        }
+        int result = tracefs_flush(ctx);
+        if (ctx->lock != NULL) {
+            Dmod_Mutex_Unlock(ctx->lock);
+        }
+        return result;
+    }
+    if (ctx->target.ioctl == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.ioctl(ctx->target_ctx, handle ? handle->target : NULL, request, arg);
+    tracefs_record(ctx, TRACEFS_OP_IOCTL, handle ? handle->id : 0, result, 0, (uint32_t)request, 0, start);
+    return result;
+}
+
+// Implement _sync for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _sync, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.sync == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.sync(ctx->target_ctx, handle ? handle->target : NULL);
+    tracefs_record(ctx, TRACEFS_OP_SYNC, handle ? handle->id : 0, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _getc for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _getc, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.getc == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.getc(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_GETC, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _putc for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _putc, (dmfsi_context_t ctx, void* fp, int c) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.putc == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.putc(ctx->target_ctx, handle->target, c);
+    tracefs_record(ctx, TRACEFS_OP_PUTC, handle->id, result, 0, (uint32_t)c, 0, start);
+    return result;
+}
+
+// Implement _tell for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, long, _tell, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.tell == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    long result = ctx->target.tell(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_TELL, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _eof for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _eof, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.eof == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.eof(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_EOF, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _size for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, long, _size, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.size == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    long result = ctx->target.size(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_SIZE, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _fflush for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fflush, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.fflush == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fflush(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_FFLUSH, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _error for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _error, (dmfsi_context_t ctx, void* fp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.error == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.error(ctx->target_ctx, handle->target);
+    tracefs_record(ctx, TRACEFS_OP_ERROR, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Helper function to open a directory, through the generic layer so a filter works on any target
+static int tracefs_opendir(dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter, uint8_t op)
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL || path == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    dmfsi_dir_t* dir = NULL;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_open(&ctx->target, ctx->target_ctx, path, filter, &dir);
+    tracefs_handle_t* handle = NULL;
+    if (result == DMFSI_OK) {
+        handle = tracefs_handle_new(ctx, dir);
+        if (handle == NULL) {
+            dmfsi_dir_close(dir);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        handle->path = tracefs_hash_dir(path);
+        *dp = handle;
+    }
+    tracefs_record(ctx, op, handle ? handle->id : 0, result, tracefs_hash(path),
+                   filter ? filter->attr_mask : 0, filter ? filter->attr_value : 0, start);
+    return result;
+}
+
+// Implement _opendir for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _opendir, (dmfsi_context_t ctx, void** dp, const char* path) )
+{
+    return tracefs_opendir(ctx, dp, path, NULL, TRACEFS_OP_OPENDIR);
+}
+
+// Implement _opendir_filter for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _opendir_filter, (dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter) )
+{
+    return tracefs_opendir(ctx, dp, path, filter, TRACEFS_OP_OPENDIR_FILTER);
+}
+
+// Implement _closedir for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _closedir, (dmfsi_context_t ctx, void* dp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)dp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_close((dmfsi_dir_t*)handle->target);
+    tracefs_record(ctx, TRACEFS_OP_CLOSEDIR, handle->id, result, 0, 0, 0, start);
+    Dmod_Free(handle);
+    return result;
+}
+
+// Implement _readdir for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _readdir, (dmfsi_context_t ctx, void* dp, dmfsi_dir_entry_t* entry) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)dp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_read((dmfsi_dir_t*)handle->target, entry);
+    tracefs_record(ctx, TRACEFS_OP_READDIR, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _stat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _stat, (dmfsi_context_t ctx, const char* path, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.stat == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.stat(ctx->target_ctx, path, stat);
+    tracefs_record(ctx, TRACEFS_OP_STAT, 0, result, tracefs_hash(path), 0, 0, start);
+    return result;
+}
+
+// Implement _fstat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fstat, (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.fstat == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)fp;
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.fstat(ctx->target_ctx, handle->target, stat);
+    tracefs_record(ctx, TRACEFS_OP_FSTAT, handle->id, result, 0, 0, 0, start);
+    return result;
+}
+
+// Implement _stat_many for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _stat_many, (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || paths == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.stat_many == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.stat_many(ctx->target_ctx, paths, count, stats, results);
+    tracefs_record_paths(ctx, TRACEFS_OP_STAT_MANY, 0, result, 0, (uint32_t)count, 0, start, paths, count);
+    return result;
+}
+
+// Implement _unlink for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _unlink, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.unlink == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.unlink(ctx->target_ctx, path);
+    tracefs_record(ctx, TRACEFS_OP_UNLINK, 0, result, tracefs_hash(path), 0, 0, start);
+    return result;
+}
+
+// Implement _rename for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _rename, (dmfsi_context_t ctx, const char* oldpath, const char* newpath) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.rename == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.rename(ctx->target_ctx, oldpath, newpath);
+    tracefs_record(ctx, TRACEFS_OP_RENAME, 0, result, tracefs_hash(oldpath), tracefs_hash(newpath), 0, start);
+    return result;
+}
+
+// Implement _chmod for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _chmod, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.chmod == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.chmod(ctx->target_ctx, path, mode);
+    tracefs_record(ctx, TRACEFS_OP_CHMOD, 0, result, tracefs_hash(path), (uint32_t)mode, 0, start);
+    return result;
+}
+
+// Implement _utime for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _utime, (dmfsi_context_t ctx, const char* path, uint32_t atime, uint32_t mtime) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.utime == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.utime(ctx->target_ctx, path, atime, mtime);
+    tracefs_record(ctx, TRACEFS_OP_UTIME, 0, result, tracefs_hash(path), atime, mtime, start);
+    return result;
+}
+
+// Implement _mkdir for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _mkdir, (dmfsi_context_t ctx, const char* path, int mode) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.mkdir == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.mkdir(ctx->target_ctx, path, mode);
+    tracefs_record(ctx, TRACEFS_OP_MKDIR, 0, result, tracefs_hash(path), (uint32_t)mode, 0, start);
+    return result;
+}
+
+// Implement _direxists for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _direxists, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ctx->target.direxists == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = ctx->target.direxists(ctx->target_ctx, path);
+    tracefs_record(ctx, TRACEFS_OP_DIREXISTS, 0, result, tracefs_hash(path), 0, 0, start);
+    return result;
+}
+
+// Implement _walk for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _walk, (dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // The generic layer lists the directories when the target can not walk
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_tree_walk(&ctx->target, ctx->target_ctx, path, callback, arg);
+    tracefs_record(ctx, TRACEFS_OP_WALK, 0, result, tracefs_hash(path), 0, 0, start);
+    return result;
+}
+
+// Implement _remove_tree for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _remove_tree, (dmfsi_context_t ctx, const char* path) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_tree_remove(&ctx->target, ctx->target_ctx, path);
+    tracefs_record(ctx, TRACEFS_OP_REMOVE_TREE, 0, result, tracefs_hash(path), 0, 0, start);
+    return result;
+}
+
+/**
+ * The directory-relative operations go through the generic layer too, it
+ * joins the path of the directory and the name when the target has only
+ * the operations on full paths.
+ */
+
+// Implement _fopenat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _fopenat, (dmfsi_context_t ctx, void** fp, void* dp, const char* name, int mode, int attr) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || fp == NULL || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* dir = (tracefs_handle_t*)dp;
+    void* target = NULL;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_fopen((dmfsi_dir_t*)dir->target, &target, name, mode, attr);
+    tracefs_handle_t* handle = NULL;
+    if (result == DMFSI_OK) {
+        handle = tracefs_handle_new(ctx, target);
+        if (handle == NULL) {
+            ctx->target.fclose(ctx->target_ctx, target);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        *fp = handle;
+    }
+    tracefs_record(ctx, TRACEFS_OP_FOPEN, handle ? handle->id : 0, result, tracefs_hash_at(dir, name),
+                   (uint32_t)mode, (uint32_t)attr, start);
+    return result;
+}
+
+// Implement _statat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _statat, (dmfsi_context_t ctx, void* dp, const char* name, dmfsi_stat_t* stat) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* dir = (tracefs_handle_t*)dp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_stat((dmfsi_dir_t*)dir->target, name, stat);
+    tracefs_record(ctx, TRACEFS_OP_STAT, 0, result, tracefs_hash_at(dir, name), 0, 0, start);
+    return result;
+}
+
+// Implement _unlinkat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _unlinkat, (dmfsi_context_t ctx, void* dp, const char* name) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* dir = (tracefs_handle_t*)dp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_unlink((dmfsi_dir_t*)dir->target, name);
+    tracefs_record(ctx, TRACEFS_OP_UNLINK, 0, result, tracefs_hash_at(dir, name), 0, 0, start);
+    return result;
+}
+
+// Implement _renameat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _renameat, (dmfsi_context_t ctx, void* olddp, const char* oldname, void* newdp, const char* newname) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || olddp == NULL || newdp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* olddir = (tracefs_handle_t*)olddp;
+    tracefs_handle_t* newdir = (tracefs_handle_t*)newdp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_rename((dmfsi_dir_t*)olddir->target, oldname, (dmfsi_dir_t*)newdir->target, newname);
+    tracefs_record(ctx, TRACEFS_OP_RENAME, 0, result, tracefs_hash_at(olddir, oldname),
+                   tracefs_hash_at(newdir, newname), 0, start);
+    return result;
+}
+
+// Implement _mkdirat for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _mkdirat, (dmfsi_context_t ctx, void* dp, const char* name, int mode) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || dp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* dir = (tracefs_handle_t*)dp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_dir_mkdir((dmfsi_dir_t*)dir->target, name, mode);
+    tracefs_record(ctx, TRACEFS_OP_MKDIR, 0, result, tracefs_hash_at(dir, name), (uint32_t)mode, 0, start);
+    return result;
+}
+
+// Implement _watch_add for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _watch_add, (dmfsi_context_t ctx, void** wp, const char* path, uint32_t mask, size_t queue_length) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || wp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    // The generic layer polls the target when it has no watches
+    dmfsi_watch_t* watch = NULL;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_watch_open(&ctx->target, ctx->target_ctx, path, mask, queue_length, &watch);
+    tracefs_handle_t* handle = NULL;
+    if (result == DMFSI_OK) {
+        handle = tracefs_handle_new(ctx, watch);
+        if (handle == NULL) {
+            dmfsi_watch_close(watch);
+            return DMFSI_ERR_NO_SPACE;
+        }
+        *wp = handle;
+    }
+    tracefs_record(ctx, TRACEFS_OP_WATCH_ADD, handle ? handle->id : 0, result, tracefs_hash(path),
+                   mask, (uint32_t)queue_length, start);
+    return result;
+}
+
+// Implement _watch_read for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _watch_read, (dmfsi_context_t ctx, void* wp, dmfsi_event_t* events, size_t count) )
+{
+    if (!TRACEFS_HOT_PATH_CTX_IS_VALID(ctx) || wp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)wp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_watch_poll((dmfsi_watch_t*)handle->target, events, count);
+    tracefs_record(ctx, TRACEFS_OP_WATCH_READ, handle->id, result, 0, (uint32_t)count, 0, start);
+    return result;
+}
+
+// Implement _watch_remove for TraceFS
+dmod_dmfsi_dif_api_declaration( 1.0, tracefs, int, _watch_remove, (dmfsi_context_t ctx, void* wp) )
+{
+    if (!ctx || ctx->magic != TRACEFS_CONTEXT_MAGIC || wp == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+
+    tracefs_handle_t* handle = (tracefs_handle_t*)wp;
+    uint32_t start = tracefs_now(ctx);
+    int result = dmfsi_watch_close((dmfsi_watch_t*)handle->target);
+    tracefs_record(ctx, TRACEFS_OP_WATCH_REMOVE, handle->id, result, 0, 0, 0, start);
+    Dmod_Free(handle);
+    return result;
+}
+
+int dmod_init(const Dmod_Config_t *Config)
+{
+    Dmod_Printf("TraceFS module initialized\n");
+    return 0;
+}
+
+int dmod_deinit(void)
+{
+    Dmod_Printf("TraceFS module deinitialized\n");
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef TRACEFS_H
+#define TRACEFS_H
+
+#include <stdint.h>
+
+/**
+ * @brief TraceFS - Recording shim for DMFSI implementations
+ *
+ * Requests accepted by the _ioctl of TraceFS. They are handled by TraceFS
+ * itself and take a NULL file handle; all other requests are passed to the
+ * traced implementation.
+ */
+
+/**
+ * @brief Microsecond clock used for the timestamps of the records
+ *
+ * The value may wrap, only the differences are used.
+ */
+typedef uint32_t (*tracefs_clock_t)(void);
+
+/**
+ * @brief Set the clock of the records, arg is tracefs_clock_t*
+ *
+ * Without a clock the trace has no timing and is replayed at full speed.
+ * Set it before the first traced call.
+ */
+#define TRACEFS_IOCTL_SET_CLOCK     0x5401
+
+/**
+ * @brief Write the buffered records to the trace file, arg is unused
+ */
+#define TRACEFS_IOCTL_FLUSH         0x5402
+
+#endif // TRACEFS_H
@@ -0,0 +1,91 @@
+#ifndef TRACEFS_TRACE_H
+#define TRACEFS_TRACE_H
+
+#include <stdint.h>
+
+/**
+ * @brief TraceFS trace format
+ *
+ * Shared by the TraceFS module and the host-side dmfsi_replay tool. All
+ * fields are little-endian. The trace is a header followed by fixed-size
+ * records, one per call, in the order the calls finished:
+ *
+ *  +----------------+  offset 0
+ *  | header         |
+ *  +----------------+  header_size
+ *  | records        |  record_size bytes each, up to the end of the file
+ *  +----------------+
+ *
+ * Paths are not stored, only their FNV-1a hashes, so a trace of a
+ * production device does not reveal the names of the files. Handles are
+ * small ids given by TraceFS when a file, directory or watch is opened.
+ * The directory-relative operations (_fopenat, _statat, ...) are recorded
+ * as the operations on the full paths, with the hashes of the full paths.
+ */
+
+#define TRACEFS_TRACE_MAGIC     0x43525444  // "DTRC" in hex
+#define TRACEFS_TRACE_VERSION   1
+
+// Trace flags
+#define TRACEFS_TRACE_TIMED     0x0001      // delta_us and duration_us are valid
+
+typedef struct {
+    uint32_t magic;             // TRACEFS_TRACE_MAGIC
+    uint16_t version;           // TRACEFS_TRACE_VERSION
+    uint16_t header_size;       // sizeof(tracefs_trace_header_t)
+    uint32_t flags;             // TRACEFS_TRACE_*
+    uint32_t record_size;       // sizeof(tracefs_record_t)
+} tracefs_trace_header_t;
+
+/**
+ * Operations, with the meaning of the record fields. `handle` is the id of
+ * the handle passed to the call, or of the new handle for the opening ones.
+ */
+#define TRACEFS_OP_FOPEN        1   // path, arg0 mode, arg1 attr, handle (new)
+#define TRACEFS_OP_FCLOSE       2   // handle
+#define TRACEFS_OP_FREAD        3   // handle, arg0 requested, arg1 read
+#define TRACEFS_OP_FWRITE       4   // handle, arg0 requested, arg1 written
+#define TRACEFS_OP_LSEEK        5   // handle, arg0 offset, arg1 whence
+#define TRACEFS_OP_IOCTL        6   // handle, arg0 request
+#define TRACEFS_OP_SYNC         7   // handle
+#define TRACEFS_OP_GETC         8   // handle
+#define TRACEFS_OP_PUTC         9   // handle, arg0 character
+#define TRACEFS_OP_TELL         10  // handle
+#define TRACEFS_OP_EOF          11  // handle
+#define TRACEFS_OP_SIZE         12  // handle
+#define TRACEFS_OP_FFLUSH       13  // handle
+#define TRACEFS_OP_ERROR        14  // handle
+#define TRACEFS_OP_OPENDIR      15  // path, handle (new)
+#define TRACEFS_OP_CLOSEDIR     16  // handle
+#define TRACEFS_OP_READDIR      17  // handle
+#define TRACEFS_OP_STAT         18  // path
+#define TRACEFS_OP_FSTAT        19  // handle
+#define TRACEFS_OP_STAT_MANY    20  // arg0 count, preceded by `count` TRACEFS_OP_PATH records
+#define TRACEFS_OP_UNLINK       21  // path
+#define TRACEFS_OP_RENAME       22  // path, arg0 hash of the new path
+#define TRACEFS_OP_CHMOD        23  // path, arg0 mode
+#define TRACEFS_OP_UTIME        24  // path, arg0 atime, arg1 mtime
+#define TRACEFS_OP_MKDIR        25  // path, arg0 mode
+#define TRACEFS_OP_DIREXISTS    26  // path
+#define TRACEFS_OP_WATCH_ADD    27  // path, arg0 mask, arg1 queue length, handle (new)
+#define TRACEFS_OP_WATCH_READ   28  // handle, arg0 count
+#define TRACEFS_OP_WATCH_REMOVE 29  // handle
+#define TRACEFS_OP_PATH         30  // path - argument of the next multi-path call
+#define TRACEFS_OP_WALK         31  // path
+#define TRACEFS_OP_REMOVE_TREE  32  // path
+#define TRACEFS_OP_OPENDIR_FILTER 33 // path, arg0 attr_mask, arg1 attr_value, handle (new)
+#define TRACEFS_OP_COUNT        34
+
+typedef struct {
+    uint8_t op;                 // TRACEFS_OP_*
+    uint8_t reserved;
+    uint16_t handle;            // Handle id, 0 - none
+    int32_t result;             // Value returned by the implementation
+    uint32_t path;              // FNV-1a hash of the path, 0 - none
+    uint32_t arg0;              // Arguments, see TRACEFS_OP_*
+    uint32_t arg1;
+    uint32_t delta_us;          // Time from the start of the previous record, 0 if it started later
+    uint32_t duration_us;       // Time spent in the implementation
+} tracefs_record_t;
+
+#endif // TRACEFS_TRACE_H
@@ -36,6 +36,8 @@ typedef struct dmfsi_context* dmfsi_context_t;
 #define DMFSI_SEEK_SET    0
 #define DMFSI_SEEK_CUR    1
 #define DMFSI_SEEK_END    2
+#define DMFSI_SEEK_DATA   3     // Next offset that holds data
+#define DMFSI_SEEK_HOLE   4     // Next offset in a hole (the end of the file counts as one)
 
 // File attributes
 #define DMFSI_ATTR_READONLY   0x01
@@ -146,6 +148,12 @@ dmod_dmfsi_dif( 1.0, int, _fwrite, (dmfsi_context_t ctx, void* fp, const void* b
  * @param offset Offset to seek to
  * @param whence Seek mode (DMFSI_SEEK_*)
  * @return The new position, or negative error code
+ *
+ * Seeking past the end and writing leaves a hole that reads as zeros.
+ * DMFSI_SEEK_DATA and DMFSI_SEEK_HOLE return DMFSI_ERR_NOT_FOUND when the
+ * offset is at or past the end of the file or no data follows it.
+ * Implementations that do not track holes may reject them with
+ * DMFSI_ERR_INVALID - the whole file is data then.
  */
 dmod_dmfsi_dif( 1.0, long, _lseek, (dmfsi_context_t ctx, void* fp, long offset, int whence) );
 
@@ -250,6 +258,39 @@ dmod_dmfsi_dif( 1.0, int, _closedir, (dmfsi_context_t ctx, void* dp) );
  */
 dmod_dmfsi_dif( 1.0, int, _readdir, (dmfsi_context_t ctx, void* dp, dmfsi_dir_entry_t* entry) );
 
+/**
+ * @brief Filter of a directory listing
+ *
+ * An entry is listed when its name (relative to the directory) starts with
+ * @p prefix, matches @p pattern and has the attributes selected by
+ * @p attr_mask set as in @p attr_value. E.g. the log files, not directories:
+ *
+ *      { .pattern = "*.log", .attr_mask = DMFSI_ATTR_DIRECTORY, .attr_value = 0 }
+ *
+ * The pattern may use `*` (any characters), `?` (one character), `[a-z]`
+ * and `[!a-z]` (one of / none of the characters) and `\` to escape them.
+ */
+typedef struct {
+    const char* pattern;    // Glob of the names, NULL - any name
+    const char* prefix;     // Start of the names, NULL - any name
+    uint32_t attr_mask;     // Attributes checked (DMFSI_ATTR_*), 0 - any
+    uint32_t attr_value;    // Required values of the checked attributes
+} dmfsi_dir_filter_t;
+
+/**
+ * @brief Open a directory, listing only the entries that match a filter
+ *
+ * The handle is read with _readdir and closed with _closedir. The strings of
+ * the filter must stay valid until the directory is closed.
+ *
+ * @param ctx File system context
+ * @param dp Pointer to store the directory handle
+ * @param path Path to the directory
+ * @param filter Filter of the entries, NULL - all entries
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _opendir_filter, (dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter) );
+
 /**
  * @brief Get file/directory statistics
  * @param ctx File system context
@@ -259,6 +300,30 @@ dmod_dmfsi_dif( 1.0, int, _readdir, (dmfsi_context_t ctx, void* dp, dmfsi_dir_en
  */
 dmod_dmfsi_dif( 1.0, int, _stat, (dmfsi_context_t ctx, const char* path, dmfsi_stat_t* stat) );
 
+/**
+ * @brief Get statistics of an already opened file
+ * @param ctx File system context
+ * @param fp File handle
+ * @param stat Pointer to store the statistics
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _fstat, (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat) );
+
+/**
+ * @brief Get statistics of multiple files/directories in a single call
+ *
+ * Each entry of @p results receives DMFSI_OK or the error code for the
+ * corresponding path; @p stats is only filled for entries that succeeded.
+ *
+ * @param ctx File system context
+ * @param paths Array of paths
+ * @param count Number of entries in @p paths, @p stats and @p results
+ * @param stats Array to store the statistics
+ * @param results Array to store the per-entry status
+ * @return Number of entries found, or negative error code
+ */
+dmod_dmfsi_dif( 1.0, int, _stat_many, (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results) );
+
 /**
  * @brief Delete a file
  * @param ctx File system context
@@ -312,4 +377,458 @@ dmod_dmfsi_dif( 1.0, int, _mkdir, (dmfsi_context_t ctx, const char* path, int mo
  */
 dmod_dmfsi_dif( 1.0, int, _direxists, (dmfsi_context_t ctx, const char* path) );
 
+/**
+ * @brief Callback of _walk, called for every file and directory
+ * @param arg Argument given to _walk
+ * @param path Full path of the entry
+ * @param stat Statistics of the entry
+ * @return 0 to continue the walk, any other value stops it
+ */
+typedef int (*dmfsi_walk_fn_t)(void* arg, const char* path, const dmfsi_stat_t* stat);
+
+/**
+ * @brief Walk a directory tree inside the file system
+ *
+ * Reports every file and directory below @p path (and @p path itself when
+ * it is a file), depth-first: a directory before its contents. The callback
+ * must not change the file system.
+ *
+ * @param ctx File system context
+ * @param path Root of the walk
+ * @param callback Function called for every entry
+ * @param arg Argument passed to the callback
+ * @return DMFSI_OK when all entries were reported, the non-zero value
+ *         returned by the callback when it stopped the walk, or negative
+ *         error code
+ */
+dmod_dmfsi_dif( 1.0, int, _walk, (dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg) );
+
+/**
+ * @brief Remove a file or a directory with everything below it
+ * @param ctx File system context
+ * @param path Path of the file or directory
+ * @return Number of removed files and directories, or negative error code
+ */
+dmod_dmfsi_dif( 1.0, int, _remove_tree, (dmfsi_context_t ctx, const char* path) );
+
+/**
+ * Directory-relative operations
+ *
+ * The operations below take a directory handle from _opendir or
+ * _opendir_filter and a name relative to that directory, so the
+ * implementation can resolve the directory once, when it is opened, instead
+ * of on every call. A name starting with '/' is an absolute path and the
+ * directory handle is ignored.
+ */
+
+/**
+ * @brief Open a file relative to a directory, see _fopen
+ * @param ctx File system context
+ * @param fp Pointer to store file handle
+ * @param dp Directory handle
+ * @param name Name of the file in the directory
+ * @param mode Open mode flags (DMFSI_O_*)
+ * @param attr File attributes (DMFSI_ATTR_*)
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _fopenat, (dmfsi_context_t ctx, void** fp, void* dp, const char* name, int mode, int attr) );
+
+/**
+ * @brief Get statistics of a file relative to a directory, see _stat
+ * @param ctx File system context
+ * @param dp Directory handle
+ * @param name Name of the file in the directory
+ * @param stat Pointer to store file statistics
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _statat, (dmfsi_context_t ctx, void* dp, const char* name, dmfsi_stat_t* stat) );
+
+/**
+ * @brief Delete a file relative to a directory, see _unlink
+ * @param ctx File system context
+ * @param dp Directory handle
+ * @param name Name of the file in the directory
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _unlinkat, (dmfsi_context_t ctx, void* dp, const char* name) );
+
+/**
+ * @brief Rename a file relative to directories, see _rename
+ * @param ctx File system context
+ * @param olddp Directory handle of the old name
+ * @param oldname Old name of the file
+ * @param newdp Directory handle of the new name
+ * @param newname New name of the file
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _renameat, (dmfsi_context_t ctx, void* olddp, const char* oldname, void* newdp, const char* newname) );
+
+/**
+ * @brief Create a directory relative to a directory, see _mkdir
+ * @param ctx File system context
+ * @param dp Directory handle
+ * @param name Name of the new directory
+ * @param mode Directory permissions
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _mkdirat, (dmfsi_context_t ctx, void* dp, const char* name, int mode) );
+
+/**
+ * @brief Change events reported by watches (DMFSI_EVENT_*)
+ *
+ * A rename is reported as a RENAME_FROM event with the old path followed by
+ * a RENAME_TO event with the new path, both with the same cookie.
+ */
+#define DMFSI_EVENT_CREATE        0x01
+#define DMFSI_EVENT_MODIFY        0x02
+#define DMFSI_EVENT_DELETE        0x04
+#define DMFSI_EVENT_RENAME_FROM   0x08
+#define DMFSI_EVENT_RENAME_TO     0x10
+#define DMFSI_EVENT_RENAME        (DMFSI_EVENT_RENAME_FROM | DMFSI_EVENT_RENAME_TO)
+#define DMFSI_EVENT_ALL           0x1F
+#define DMFSI_EVENT_OVERFLOW      0x80  // The queue was full and events were lost, always reported
+
+/**
+ * @brief Change event
+ */
+typedef struct {
+    uint32_t type;          // DMFSI_EVENT_*
+    uint32_t cookie;        // Pairs the two events of a rename
+    char path[256];         // Path of the changed file
+} dmfsi_event_t;
+
+/**
+ * @brief Start watching a file or a directory for changes
+ *
+ * A watch on a directory reports changes of all files below it. Events are
+ * kept in a queue of @p queue_length entries until they are read; when it
+ * is full, further events are dropped and DMFSI_EVENT_OVERFLOW is reported.
+ *
+ * @param ctx File system context
+ * @param wp Pointer to store the watch handle
+ * @param path Path of the file or directory
+ * @param mask Events of interest (DMFSI_EVENT_*)
+ * @param queue_length Maximum number of queued events (0 - default)
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _watch_add, (dmfsi_context_t ctx, void** wp, const char* path, uint32_t mask, size_t queue_length) );
+
+/**
+ * @brief Take the queued events of a watch, without waiting
+ * @param ctx File system context
+ * @param wp Watch handle
+ * @param events Array to store the events
+ * @param count Size of the array
+ * @return Number of events stored, or negative error code
+ */
+dmod_dmfsi_dif( 1.0, int, _watch_read, (dmfsi_context_t ctx, void* wp, dmfsi_event_t* events, size_t count) );
+
+/**
+ * @brief Stop watching
+ * @param ctx File system context
+ * @param wp Watch handle
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_dif( 1.0, int, _watch_remove, (dmfsi_context_t ctx, void* wp) );
+
+/**
+ * @brief List of DMFSI operations as (return type, name, parameters)
+ *
+ * Used to build the operations table, its resolver and the static
+ * dispatch declarations from a single list. @p ARG is passed through to
+ * every @p X invocation. DMFSI_OPS_BASE_LIST has the operations every
+ * implementation defines, DMFSI_OPS_OPTIONAL_LIST the ones it may leave out.
+ */
+#define DMFSI_OPS_LIST(X, ARG) \
+    DMFSI_OPS_BASE_LIST(X, ARG) \
+    DMFSI_OPS_OPTIONAL_LIST(X, ARG)
+
+#define DMFSI_OPS_BASE_LIST(X, ARG) \
+    X(ARG, dmfsi_context_t, init,          (const char* config)) \
+    X(ARG, int,             deinit,        (dmfsi_context_t ctx)) \
+    X(ARG, int,             context_is_valid, (dmfsi_context_t ctx)) \
+    X(ARG, int,             fopen,         (dmfsi_context_t ctx, void** fp, const char* path, int mode, int attr)) \
+    X(ARG, int,             fclose,        (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             fread,         (dmfsi_context_t ctx, void* fp, void* buffer, size_t size, size_t* read)) \
+    X(ARG, int,             fwrite,        (dmfsi_context_t ctx, void* fp, const void* buffer, size_t size, size_t* written)) \
+    X(ARG, long,            lseek,         (dmfsi_context_t ctx, void* fp, long offset, int whence)) \
+    X(ARG, int,             ioctl,         (dmfsi_context_t ctx, void* fp, int request, void* arg)) \
+    X(ARG, int,             sync,          (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             getc,          (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             putc,          (dmfsi_context_t ctx, void* fp, int c)) \
+    X(ARG, long,            tell,          (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             eof,           (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, long,            size,          (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             fflush,        (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             error,         (dmfsi_context_t ctx, void* fp)) \
+    X(ARG, int,             opendir,       (dmfsi_context_t ctx, void** dp, const char* path)) \
+    X(ARG, int,             closedir,      (dmfsi_context_t ctx, void* dp)) \
+    X(ARG, int,             readdir,       (dmfsi_context_t ctx, void* dp, dmfsi_dir_entry_t* entry)) \
+    X(ARG, int,             stat,          (dmfsi_context_t ctx, const char* path, dmfsi_stat_t* stat)) \
+    X(ARG, int,             fstat,         (dmfsi_context_t ctx, void* fp, dmfsi_stat_t* stat)) \
+    X(ARG, int,             stat_many,     (dmfsi_context_t ctx, const char* const* paths, size_t count, dmfsi_stat_t* stats, int* results)) \
+    X(ARG, int,             unlink,        (dmfsi_context_t ctx, const char* path)) \
+    X(ARG, int,             rename,        (dmfsi_context_t ctx, const char* oldpath, const char* newpath)) \
+    X(ARG, int,             chmod,         (dmfsi_context_t ctx, const char* path, int mode)) \
+    X(ARG, int,             utime,         (dmfsi_context_t ctx, const char* path, uint32_t atime, uint32_t mtime)) \
+    X(ARG, int,             mkdir,         (dmfsi_context_t ctx, const char* path, int mode)) \
+    X(ARG, int,             direxists,     (dmfsi_context_t ctx, const char* path))
+
+#define DMFSI_OPS_OPTIONAL_LIST(X, ARG) \
+    X(ARG, int,             opendir_filter, (dmfsi_context_t ctx, void** dp, const char* path, const dmfsi_dir_filter_t* filter)) \
+    X(ARG, int,             walk,          (dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg)) \
+    X(ARG, int,             remove_tree,   (dmfsi_context_t ctx, const char* path)) \
+    X(ARG, int,             fopenat,       (dmfsi_context_t ctx, void** fp, void* dp, const char* name, int mode, int attr)) \
+    X(ARG, int,             statat,        (dmfsi_context_t ctx, void* dp, const char* name, dmfsi_stat_t* stat)) \
+    X(ARG, int,             unlinkat,      (dmfsi_context_t ctx, void* dp, const char* name)) \
+    X(ARG, int,             renameat,      (dmfsi_context_t ctx, void* olddp, const char* oldname, void* newdp, const char* newname)) \
+    X(ARG, int,             mkdirat,       (dmfsi_context_t ctx, void* dp, const char* name, int mode)) \
+    X(ARG, int,             watch_add,     (dmfsi_context_t ctx, void** wp, const char* path, uint32_t mask, size_t queue_length)) \
+    X(ARG, int,             watch_read,    (dmfsi_context_t ctx, void* wp, dmfsi_event_t* events, size_t count)) \
+    X(ARG, int,             watch_remove,  (dmfsi_context_t ctx, void* wp))
+
+#define DMFSI_OPS_FIELD(ARG, RET, NAME, PARAMS)  RET (*NAME) PARAMS;
+
+/**
+ * @brief Pre-resolved operations table of a single DMFSI implementation
+ *
+ * Resolving the DIF functions once and keeping the table avoids going
+ * through the DIF lookup on every call. Operations not provided by the
+ * implementation are left NULL.
+ */
+typedef struct {
+    DMFSI_OPS_LIST(DMFSI_OPS_FIELD, ~)
+} dmfsi_ops_t;
+
+/**
+ * @brief Resolve the operations table of a DMFSI implementation
+ * @param module Module context of the implementation
+ * @param ops Pointer to store the resolved operations
+ * @return DMFSI_OK on success, DMFSI_ERR_NOT_FOUND if a mandatory operation is missing
+ */
+dmod_dmfsi_api( 1.0, int, _ops_resolve, (Dmod_Context_t* module, dmfsi_ops_t* ops) );
+
+/**
+ * @brief Resolve the operations table of a DMFSI implementation by its module name
+ * @param name Name of the module implementing DMFSI (e.g. "ramfs")
+ * @param ops Pointer to store the resolved operations
+ * @return DMFSI_OK on success, DMFSI_ERR_NOT_FOUND if there is no such implementation
+ */
+dmod_dmfsi_api( 1.0, int, _ops_resolve_by_name, (const char* name, dmfsi_ops_t* ops) );
+
+/**
+ * @brief Watch created by the generic layer
+ *
+ * Uses the native watch of the implementation when it provides one (see
+ * _watch_add), otherwise it detects changes by comparing listings of the
+ * whole tree (see dmfsi_tree_walk, or the _stat of a file) each time it is
+ * polled. The polling fallback can
+ * not tell a rename from a delete and a create, and sees modifications only
+ * as changes of size or time.
+ */
+typedef struct dmfsi_watch dmfsi_watch_t;
+
+/**
+ * @brief Start watching a file or a directory for changes
+ * @param ops Operations of the implementation
+ * @param ctx File system context
+ * @param path Path of the file or directory
+ * @param mask Events of interest (DMFSI_EVENT_*)
+ * @param queue_length Maximum number of queued events (0 - default)
+ * @param watch Pointer to store the watch
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _watch_open, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, uint32_t mask, size_t queue_length, dmfsi_watch_t** watch) );
+
+/**
+ * @brief Take the events of a watch - with the polling fallback this is
+ *        also when the changes are detected
+ * @param watch Watch
+ * @param events Array to store the events
+ * @param count Size of the array
+ * @return Number of events stored, or negative error code
+ */
+dmod_dmfsi_api( 1.0, int, _watch_poll, (dmfsi_watch_t* watch, dmfsi_event_t* events, size_t count) );
+
+/**
+ * @brief Stop watching and free the watch
+ * @param watch Watch
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _watch_close, (dmfsi_watch_t* watch) );
+
+/**
+ * @brief Check if a directory entry matches a filter
+ * @param filter Filter, NULL matches every entry
+ * @param name Name of the entry, relative to the directory
+ * @param attr Attributes of the entry
+ * @return 1 if the entry matches, 0 otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_filter_match, (const dmfsi_dir_filter_t* filter, const char* name, uint32_t attr) );
+
+/**
+ * @brief Directory opened by the generic layer
+ *
+ * Uses _opendir_filter of the implementation when it provides one,
+ * otherwise it reads the whole directory with _readdir and skips the entries
+ * that do not match the filter.
+ */
+typedef struct dmfsi_dir dmfsi_dir_t;
+
+/**
+ * @brief Open a directory with a filter, see _opendir_filter
+ * @param ops Operations of the implementation
+ * @param ctx File system context
+ * @param path Path to the directory
+ * @param filter Filter of the entries, NULL - all entries
+ * @param dir Pointer to store the directory
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_open, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, const dmfsi_dir_filter_t* filter, dmfsi_dir_t** dir) );
+
+/**
+ * @brief Read the next matching entry of a directory
+ * @param dir Directory
+ * @param entry Pointer to store the entry
+ * @return DMFSI_OK on success, error code otherwise (DMFSI_ERR_NOT_FOUND at end)
+ */
+dmod_dmfsi_api( 1.0, int, _dir_read, (dmfsi_dir_t* dir, dmfsi_dir_entry_t* entry) );
+
+/**
+ * @brief Close a directory and free it
+ * @param dir Directory
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_close, (dmfsi_dir_t* dir) );
+
+/**
+ * @brief Open a file in a directory, see _fopenat
+ *
+ * The functions below use the directory-relative operations of the
+ * implementation when it provides them, otherwise they join the path of the
+ * directory and the name and call the operations on the full path.
+ *
+ * @param dir Directory
+ * @param fp Pointer to store file handle, used with the operations of the directory
+ * @param name Name of the file in the directory
+ * @param mode Open mode flags (DMFSI_O_*)
+ * @param attr File attributes (DMFSI_ATTR_*)
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_fopen, (dmfsi_dir_t* dir, void** fp, const char* name, int mode, int attr) );
+
+/**
+ * @brief Get statistics of a file in a directory, see _statat
+ * @param dir Directory
+ * @param name Name of the file in the directory
+ * @param stat Pointer to store file statistics
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_stat, (dmfsi_dir_t* dir, const char* name, dmfsi_stat_t* stat) );
+
+/**
+ * @brief Delete a file in a directory, see _unlinkat
+ * @param dir Directory
+ * @param name Name of the file in the directory
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_unlink, (dmfsi_dir_t* dir, const char* name) );
+
+/**
+ * @brief Rename a file between directories of one file system, see _renameat
+ * @param olddir Directory of the old name
+ * @param oldname Old name of the file
+ * @param newdir Directory of the new name
+ * @param newname New name of the file
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_rename, (dmfsi_dir_t* olddir, const char* oldname, dmfsi_dir_t* newdir, const char* newname) );
+
+/**
+ * @brief Create a directory in a directory, see _mkdirat
+ * @param dir Directory
+ * @param name Name of the new directory
+ * @param mode Directory permissions
+ * @return DMFSI_OK on success, error code otherwise
+ */
+dmod_dmfsi_api( 1.0, int, _dir_mkdir, (dmfsi_dir_t* dir, const char* name, int mode) );
+
+/**
+ * @brief Walk a directory tree, see _walk
+ *
+ * Uses _walk of the implementation when it provides one, otherwise lists
+ * the directories with _opendir/_readdir.
+ *
+ * @param ops Operations of the implementation
+ * @param ctx File system context
+ * @param path Root of the walk
+ * @param callback Function called for every entry
+ * @param arg Argument passed to the callback
+ * @return DMFSI_OK, the non-zero value returned by the callback, or negative error code
+ */
+dmod_dmfsi_api( 1.0, int, _tree_walk, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg) );
+
+/**
+ * @brief Remove a directory tree, see _remove_tree
+ *
+ * Uses _remove_tree of the implementation when it provides one, otherwise
+ * removes the entries one by one with _unlink, the contents of a directory
+ * before the directory.
+ *
+ * @param ops Operations of the implementation
+ * @param ctx File system context
+ * @param path Path of the file or directory
+ * @return Number of removed files and directories, or negative error code
+ */
+dmod_dmfsi_api( 1.0, int, _tree_remove, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path) );
+
+/**
+ * @brief Validation of the context in data-path operations
+ *
+ * Implementations always validate the context when a handle is created
+ * (_fopen, _opendir). When this is set to 0, operations on an already
+ * opened handle (_fread, _fwrite, _getc, _putc, _tell, _eof, _size) only
+ * check the handle itself.
+ */
+#ifndef DMFSI_VALIDATE_HOT_PATH
+#   define DMFSI_VALIDATE_HOT_PATH  1
+#endif
+
+/**
+ * @brief Static dispatch for DMOD_SYSTEM builds
+ *
+ * In DMOD_SYSTEM mode the implementations are linked statically, so their
+ * functions can be called directly. DMFSI_STATIC_OPS(impl) gives a constant
+ * operations table of the implementation, that the compiler can see through.
+ * When DMFSI_STATIC_IMPL is defined, DMFSI_CALL(ops, name) calls the
+ * function of that implementation directly instead of through @p ops.
+ *
+ * DMFSI_DECLARE_STATIC_IMPL(impl) declares the optional operations weak, so
+ * the ones that an implementation does not provide are NULL in its table.
+ * The other operations are strong references, which also pull the
+ * implementation out of a static library. The declarations of
+ * DMFSI_STATIC_IMPL are all strong, a call of a missing operation fails to
+ * link instead of calling NULL.
+ */
+#define DMFSI_STATIC_FUNCTION_(IMPL, NAME)  dmfsi_##IMPL##_##NAME
+#define DMFSI_STATIC_FUNCTION(IMPL, NAME)   DMFSI_STATIC_FUNCTION_(IMPL, NAME)
+
+#ifdef DMOD_SYSTEM
+#   define DMFSI_STATIC_PROTOTYPE_(IMPL, RET, NAME, PARAMS)   extern RET DMFSI_STATIC_FUNCTION(IMPL, NAME) PARAMS;
+#   define DMFSI_STATIC_WEAK_PROTOTYPE_(IMPL, RET, NAME, PARAMS) extern RET DMFSI_STATIC_FUNCTION(IMPL, NAME) PARAMS __attribute__((weak));
+#   define DMFSI_STATIC_INITIALIZER_(IMPL, RET, NAME, PARAMS) .NAME = DMFSI_STATIC_FUNCTION(IMPL, NAME),
+#   define DMFSI_DECLARE_STATIC_IMPL(IMPL) \
+        DMFSI_OPS_BASE_LIST(DMFSI_STATIC_PROTOTYPE_, IMPL) \
+        DMFSI_OPS_OPTIONAL_LIST(DMFSI_STATIC_WEAK_PROTOTYPE_, IMPL)
+#   define DMFSI_STATIC_OPS(IMPL) \
+        ((const dmfsi_ops_t){ DMFSI_OPS_LIST(DMFSI_STATIC_INITIALIZER_, IMPL) })
+#endif
+
+#if defined(DMOD_SYSTEM) && defined(DMFSI_STATIC_IMPL)
+DMFSI_OPS_LIST(DMFSI_STATIC_PROTOTYPE_, DMFSI_STATIC_IMPL)
+#   define DMFSI_CALL(OPS, NAME)   DMFSI_STATIC_FUNCTION(DMFSI_STATIC_IMPL, NAME)
+#else
+#   define DMFSI_CALL(OPS, NAME)   ((OPS)->NAME)
+#endif
+
 #endif // DMFSI_H
@@ -15,6 +15,879 @@
 // This module doesn't need to define the signature variables anymore
 // They're now macros defined in the header
 
+// Resolves a single DIF function of the implementation into the table
+#define DMFSI_OPS_RESOLVE(MODULE, RET, NAME, PARAMS) \
+    ops->NAME = (RET (*) PARAMS)Dmod_GetDifFunction(MODULE, dmod_dmfsi_##NAME##_sig);
+
+dmod_dmfsi_api_declaration( 1.0, int, _ops_resolve, (Dmod_Context_t* module, dmfsi_ops_t* ops) )
+{
+    if (module == NULL || ops == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    DMFSI_OPS_LIST(DMFSI_OPS_RESOLVE, module)
+    
+    // Without these operations the implementation can't be used at all,
+    // the others are optional and are left NULL when not provided
+    if (ops->init == NULL || ops->deinit == NULL || ops->context_is_valid == NULL
+        || ops->fopen == NULL || ops->fclose == NULL
+        || ops->fread == NULL || ops->fwrite == NULL) {
+        Dmod_Printf("DMFSI: module does not implement mandatory operations\n");
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    
+    return DMFSI_OK;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _ops_resolve_by_name, (const char* name, dmfsi_ops_t* ops) )
+{
+    if (name == NULL || ops == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    Dmod_Context_t* module = Dmod_GetNextDifModule(dmod_dmfsi_init_sig, NULL);
+    while (module != NULL) {
+        const char* s1 = Dmod_GetName(module);
+        const char* s2 = name;
+        while (s1 != NULL && *s1 && *s1 == *s2) {
+            s1++;
+            s2++;
+        }
+        if (s1 != NULL && *s1 == '\0' && *s2 == '\0') {
+            return dmfsi_ops_resolve(module, ops);
+        }
+        module = Dmod_GetNextDifModule(dmod_dmfsi_init_sig, module);
+    }
+    
+    Dmod_Printf("DMFSI: implementation '%s' not found\n", name);
+    return DMFSI_ERR_NOT_FOUND;
+}
+
+#define DMFSI_WATCH_DEFAULT_QUEUE   16
+
+// File seen by a polling watch
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t time;
+    char* path;
+} dmfsi_watch_entry_t;
+
+struct dmfsi_watch {
+    dmfsi_ops_t ops;
+    dmfsi_context_t ctx;
+    void* native;                   // Watch of the implementation, NULL when polling
+    uint32_t mask;
+    int is_dir;
+    size_t path_length;
+    char path[256];
+    dmfsi_watch_entry_t* entries;   // Last listing, sorted by hash and path
+    size_t entry_count;
+    dmfsi_event_t* queue;           // Events not taken yet
+    size_t queue_length;
+    size_t queue_head;
+    size_t queue_count;
+    int overflow;
+};
+
+static size_t dmfsi_strlen(const char* s)
+{
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+static int dmfsi_strcmp(const char* s1, const char* s2)
+{
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+static uint32_t dmfsi_hash(const char* s)
+{
+    uint32_t hash = 2166136261u;
+    while (*s) {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int dmfsi_watch_entry_cmp(const dmfsi_watch_entry_t* a, const dmfsi_watch_entry_t* b)
+{
+    if (a->hash != b->hash) {
+        return (a->hash < b->hash) ? -1 : 1;
+    }
+    return dmfsi_strcmp(a->path, b->path);
+}
+
+static void dmfsi_watch_free_entries(dmfsi_watch_entry_t* entries, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        Dmod_Free(entries[i].path);
+    }
+    if (entries != NULL) {
+        Dmod_Free(entries);
+    }
+}
+
+static void dmfsi_watch_push(dmfsi_watch_t* watch, uint32_t type, const char* path)
+{
+    if ((watch->mask & type) == 0) {
+        return;
+    }
+    if (watch->queue_count == watch->queue_length) {
+        watch->overflow = 1;
+        return;
+    }
+    dmfsi_event_t* event = &watch->queue[(watch->queue_head + watch->queue_count) % watch->queue_length];
+    size_t len = dmfsi_strlen(path);
+    if (len > sizeof(event->path) - 1) {
+        len = sizeof(event->path) - 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        event->path[i] = path[i];
+    }
+    event->path[len] = '\0';
+    event->type = type;
+    event->cookie = 0;
+    watch->queue_count++;
+}
+
+// Full path of a listed entry, allocated with Dmod_Malloc
+static char* dmfsi_join(const char* dir, size_t dir_length, const char* name)
+{
+    // Implementations list either full paths or names relative to the directory
+    size_t prefix = (name[0] == '/') ? 0 : dir_length;
+    int separator = (prefix > 0 && dir[prefix - 1] != '/');
+    size_t name_length = dmfsi_strlen(name);
+    char* path = (char*)Dmod_Malloc(prefix + separator + name_length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < prefix; i++) {
+        path[i] = dir[i];
+    }
+    if (separator) {
+        path[prefix] = '/';
+    }
+    for (size_t i = 0; i <= name_length; i++) {
+        path[prefix + separator + i] = name[i];
+    }
+    return path;
+}
+
+// Add a file to a listing being built
+static int dmfsi_watch_add_entry(dmfsi_watch_entry_t** entries, size_t* count, size_t* capacity,
+                                 const char* dir, size_t dir_length, const char* name,
+                                 uint32_t size, uint32_t time)
+{
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        dmfsi_watch_entry_t* grown = (dmfsi_watch_entry_t*)Dmod_Malloc(new_capacity * sizeof(dmfsi_watch_entry_t));
+        if (grown == NULL) {
+            return DMFSI_ERR_NO_SPACE;
+        }
+        for (size_t i = 0; i < *count; i++) {
+            grown[i] = (*entries)[i];
+        }
+        if (*entries != NULL) {
+            Dmod_Free(*entries);
+        }
+        *entries = grown;
+        *capacity = new_capacity;
+    }
+
+    char* path = dmfsi_join(dir, dir_length, name);
+    if (path == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+
+    dmfsi_watch_entry_t* entry = &(*entries)[(*count)++];
+    entry->hash = dmfsi_hash(path);
+    entry->size = size;
+    entry->time = time;
+    entry->path = path;
+    return DMFSI_OK;
+}
+
+// Check if a path from a listing is inside a directory
+static int dmfsi_path_contains(const char* dir, size_t dir_length, const char* path)
+{
+    if (dir_length == 0) {
+        return 1;
+    }
+    size_t i = 0;
+    while (i < dir_length && path[i] == dir[i]) {
+        i++;
+    }
+    if (i < dir_length) {
+        return 0;
+    }
+    return (dir[i - 1] == '/' && path[i] != '\0') || path[i] == '/';
+}
+
+// Check if a path from a listing is inside the watched directory
+static int dmfsi_watch_contains(const dmfsi_watch_t* watch, const char* path)
+{
+    return dmfsi_path_contains(watch->path, watch->path_length, path);
+}
+
+// Listing of a polling watch being built
+typedef struct {
+    const dmfsi_watch_t* watch;
+    dmfsi_watch_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} dmfsi_watch_listing_t;
+
+// Walk callback of the listing, a directory is covered by the files below it
+static int dmfsi_watch_list_entry(void* arg, const char* path, const dmfsi_stat_t* stat)
+{
+    dmfsi_watch_listing_t* listing = (dmfsi_watch_listing_t*)arg;
+    if ((stat->attr & DMFSI_ATTR_DIRECTORY) || !dmfsi_watch_contains(listing->watch, path)) {
+        return DMFSI_OK;
+    }
+    return dmfsi_watch_add_entry(&listing->entries, &listing->count, &listing->capacity,
+                                 path, 0, path, stat->size, stat->mtime);
+}
+
+// List the watched files, the whole tree of a directory, sorted by hash and path
+static int dmfsi_watch_scan(dmfsi_watch_t* watch, dmfsi_watch_entry_t** entries, size_t* count)
+{
+    dmfsi_watch_listing_t listing = { watch, NULL, 0, 0 };
+    int result = DMFSI_OK;
+
+    if (watch->is_dir) {
+        result = dmfsi_tree_walk(&watch->ops, watch->ctx, watch->path, dmfsi_watch_list_entry, &listing);
+    } else {
+        dmfsi_stat_t stat;
+        if (watch->ops.stat(watch->ctx, watch->path, &stat) == DMFSI_OK) {
+            result = dmfsi_watch_add_entry(&listing.entries, &listing.count, &listing.capacity,
+                                           watch->path, 0, watch->path, stat.size, stat.mtime);
+        }
+    }
+    *entries = listing.entries;
+    *count = listing.count;
+    if (result != DMFSI_OK) {
+        dmfsi_watch_free_entries(*entries, *count);
+        *entries = NULL;
+        *count = 0;
+        return result;
+    }
+
+    // Shell sort - the listing is compared with the previous one in a single pass
+    for (size_t gap = *count / 2; gap > 0; gap /= 2) {
+        for (size_t i = gap; i < *count; i++) {
+            dmfsi_watch_entry_t tmp = (*entries)[i];
+            size_t j = i;
+            while (j >= gap && dmfsi_watch_entry_cmp(&(*entries)[j - gap], &tmp) > 0) {
+                (*entries)[j] = (*entries)[j - gap];
+                j -= gap;
+            }
+            (*entries)[j] = tmp;
+        }
+    }
+    return DMFSI_OK;
+}
+
+// Compare a new listing with the previous one and queue the differences
+static int dmfsi_watch_update(dmfsi_watch_t* watch)
+{
+    dmfsi_watch_entry_t* entries;
+    size_t count;
+    int result = dmfsi_watch_scan(watch, &entries, &count);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    
+    size_t i = 0;
+    size_t j = 0;
+    while (i < watch->entry_count || j < count) {
+        int cmp;
+        if (i == watch->entry_count) {
+            cmp = 1;
+        } else if (j == count) {
+            cmp = -1;
+        } else {
+            cmp = dmfsi_watch_entry_cmp(&watch->entries[i], &entries[j]);
+        }
+        
+        if (cmp < 0) {
+            dmfsi_watch_push(watch, DMFSI_EVENT_DELETE, watch->entries[i++].path);
+        } else if (cmp > 0) {
+            dmfsi_watch_push(watch, DMFSI_EVENT_CREATE, entries[j++].path);
+        } else {
+            if (watch->entries[i].size != entries[j].size || watch->entries[i].time != entries[j].time) {
+                dmfsi_watch_push(watch, DMFSI_EVENT_MODIFY, entries[j].path);
+            }
+            i++;
+            j++;
+        }
+    }
+    
+    dmfsi_watch_free_entries(watch->entries, watch->entry_count);
+    watch->entries = entries;
+    watch->entry_count = count;
+    return DMFSI_OK;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _watch_open, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, uint32_t mask, size_t queue_length, dmfsi_watch_t** watch) )
+{
+    if (ops == NULL || path == NULL || watch == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    size_t path_length = dmfsi_strlen(path);
+    if (path_length == 0 || path_length >= sizeof(((dmfsi_watch_t*)0)->path)) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    dmfsi_watch_t* w = (dmfsi_watch_t*)Dmod_Malloc(sizeof(dmfsi_watch_t));
+    if (w == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    w->ops = *ops;
+    w->ctx = ctx;
+    w->native = NULL;
+    w->mask = mask;
+    w->path_length = path_length;
+    for (size_t i = 0; i <= path_length; i++) {
+        w->path[i] = path[i];
+    }
+    w->entries = NULL;
+    w->entry_count = 0;
+    w->queue = NULL;
+    w->queue_length = queue_length ? queue_length : DMFSI_WATCH_DEFAULT_QUEUE;
+    w->queue_head = 0;
+    w->queue_count = 0;
+    w->overflow = 0;
+    
+    int result;
+    if (ops->watch_add != NULL) {
+        result = ops->watch_add(ctx, &w->native, path, mask, queue_length);
+    } else if (ops->stat == NULL) {
+        result = DMFSI_ERR_NOT_FOUND;
+    } else {
+        // No native support - remember the current state and compare with it when polled
+        w->is_dir = ops->opendir != NULL && ops->readdir != NULL && ops->closedir != NULL
+                 && ops->direxists != NULL && ops->direxists(ctx, path) == 1;
+        w->queue = (dmfsi_event_t*)Dmod_Malloc(w->queue_length * sizeof(dmfsi_event_t));
+        result = (w->queue == NULL) ? DMFSI_ERR_NO_SPACE
+                                    : dmfsi_watch_scan(w, &w->entries, &w->entry_count);
+    }
+    if (result != DMFSI_OK) {
+        if (w->queue != NULL) {
+            Dmod_Free(w->queue);
+        }
+        Dmod_Free(w);
+        return result;
+    }
+    
+    *watch = w;
+    return DMFSI_OK;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _watch_poll, (dmfsi_watch_t* watch, dmfsi_event_t* events, size_t count) )
+{
+    if (watch == NULL || events == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (watch->native != NULL) {
+        return watch->ops.watch_read(watch->ctx, watch->native, events, count);
+    }
+    
+    int result = dmfsi_watch_update(watch);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    
+    size_t taken = 0;
+    while (taken < count && watch->queue_count > 0) {
+        events[taken++] = watch->queue[watch->queue_head];
+        watch->queue_head = (watch->queue_head + 1) % watch->queue_length;
+        watch->queue_count--;
+    }
+    if (taken < count && watch->queue_count == 0 && watch->overflow) {
+        events[taken].type = DMFSI_EVENT_OVERFLOW;
+        events[taken].cookie = 0;
+        events[taken].path[0] = '\0';
+        watch->overflow = 0;
+        taken++;
+    }
+    return (int)taken;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _watch_close, (dmfsi_watch_t* watch) )
+{
+    if (watch == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    int result = DMFSI_OK;
+    if (watch->native != NULL) {
+        result = watch->ops.watch_remove(watch->ctx, watch->native);
+    }
+    dmfsi_watch_free_entries(watch->entries, watch->entry_count);
+    if (watch->queue != NULL) {
+        Dmod_Free(watch->queue);
+    }
+    Dmod_Free(watch);
+    return result;
+}
+
+// Number of pattern characters matching @p c at @p p, 0 if it does not match
+static size_t dmfsi_glob_char(const char* p, unsigned char c)
+{
+    if (*p == '?') {
+        return 1;
+    }
+    if (*p == '\\' && p[1] != '\0') {
+        return ((unsigned char)p[1] == c) ? 2 : 0;
+    }
+    if (*p == '[') {
+        const char* q = p + 1;
+        int negate = (*q == '!');
+        q += negate;
+        const char* first = q;
+        int matched = 0;
+        // A ']' right after the opening bracket is a member of the set
+        while (*q != '\0' && (*q != ']' || q == first)) {
+            if (q[1] == '-' && q[2] != '\0' && q[2] != ']') {
+                matched |= (c >= (unsigned char)q[0] && c <= (unsigned char)q[2]);
+                q += 3;
+            } else {
+                matched |= ((unsigned char)*q == c);
+                q++;
+            }
+        }
+        if (*q != ']') {
+            return (c == '[') ? 1 : 0;  // Not a set, just a bracket
+        }
+        return (matched != negate) ? (size_t)(q - p + 1) : 0;
+    }
+    return ((unsigned char)*p == c) ? 1 : 0;
+}
+
+// Glob match, a failed match is retried from the last '*' one character later
+static int dmfsi_glob(const char* pattern, const char* name)
+{
+    const char* star = NULL;
+    const char* retry = NULL;
+    while (*name != '\0') {
+        size_t length;
+        if (*pattern == '*') {
+            star = pattern++;
+            retry = name;
+        } else if (*pattern != '\0' && (length = dmfsi_glob_char(pattern, (unsigned char)*name)) > 0) {
+            pattern += length;
+            name++;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            name = ++retry;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_filter_match, (const dmfsi_dir_filter_t* filter, const char* name, uint32_t attr) )
+{
+    if (filter == NULL) {
+        return 1;
+    }
+    if ((attr & filter->attr_mask) != (filter->attr_value & filter->attr_mask)) {
+        return 0;
+    }
+    if (filter->prefix != NULL) {
+        size_t i = 0;
+        while (filter->prefix[i] != '\0' && filter->prefix[i] == name[i]) {
+            i++;
+        }
+        if (filter->prefix[i] != '\0') {
+            return 0;
+        }
+    }
+    return filter->pattern == NULL || dmfsi_glob(filter->pattern, name);
+}
+
+struct dmfsi_dir {
+    dmfsi_ops_t ops;
+    dmfsi_context_t ctx;
+    void* dp;
+    int native;                     // The implementation applies the filter
+    int filtered;
+    dmfsi_dir_filter_t filter;
+    size_t path_length;
+    char path[];                    // For the operations on names in the directory
+};
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_open, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, const dmfsi_dir_filter_t* filter, dmfsi_dir_t** dir) )
+{
+    if (ops == NULL || path == NULL || dir == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ops->readdir == NULL || ops->closedir == NULL
+        || (ops->opendir == NULL && ops->opendir_filter == NULL)) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    size_t path_length = dmfsi_strlen(path);
+    dmfsi_dir_t* d = (dmfsi_dir_t*)Dmod_Malloc(sizeof(dmfsi_dir_t) + path_length + 1);
+    if (d == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    for (size_t i = 0; i <= path_length; i++) {
+        d->path[i] = path[i];
+    }
+    d->path_length = path_length;
+    d->ops = *ops;
+    d->ctx = ctx;
+    d->native = (ops->opendir_filter != NULL);
+    d->filtered = (filter != NULL);
+    if (filter != NULL) {
+        d->filter = *filter;
+    }
+    
+    int result = d->native ? ops->opendir_filter(ctx, &d->dp, path, filter)
+                           : ops->opendir(ctx, &d->dp, path);
+    if (result != DMFSI_OK) {
+        Dmod_Free(d);
+        return result;
+    }
+    *dir = d;
+    return DMFSI_OK;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_read, (dmfsi_dir_t* dir, dmfsi_dir_entry_t* entry) )
+{
+    if (dir == NULL || entry == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    int result;
+    while ((result = dir->ops.readdir(dir->ctx, dir->dp, entry)) == DMFSI_OK) {
+        if (dir->native || !dir->filtered) {
+            return DMFSI_OK;
+        }
+        // Implementations list either full paths or names relative to the directory
+        const char* name = entry->name;
+        for (const char* p = entry->name; *p != '\0'; p++) {
+            if (*p == '/' && p[1] != '\0') {
+                name = p + 1;
+            }
+        }
+        if (dmfsi_dir_filter_match(&dir->filter, name, entry->attr)) {
+            return DMFSI_OK;
+        }
+    }
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_close, (dmfsi_dir_t* dir) )
+{
+    if (dir == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    
+    int result = dir->ops.closedir(dir->ctx, dir->dp);
+    Dmod_Free(dir);
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_fopen, (dmfsi_dir_t* dir, void** fp, const char* name, int mode, int attr) )
+{
+    if (dir == NULL || fp == NULL || name == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (dir->ops.fopenat != NULL) {
+        return dir->ops.fopenat(dir->ctx, fp, dir->dp, name, mode, attr);
+    }
+    if (dir->ops.fopen == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    char* path = dmfsi_join(dir->path, dir->path_length, name);
+    if (path == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    int result = dir->ops.fopen(dir->ctx, fp, path, mode, attr);
+    Dmod_Free(path);
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_stat, (dmfsi_dir_t* dir, const char* name, dmfsi_stat_t* stat) )
+{
+    if (dir == NULL || name == NULL || stat == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (dir->ops.statat != NULL) {
+        return dir->ops.statat(dir->ctx, dir->dp, name, stat);
+    }
+    if (dir->ops.stat == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    char* path = dmfsi_join(dir->path, dir->path_length, name);
+    if (path == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    int result = dir->ops.stat(dir->ctx, path, stat);
+    Dmod_Free(path);
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_unlink, (dmfsi_dir_t* dir, const char* name) )
+{
+    if (dir == NULL || name == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (dir->ops.unlinkat != NULL) {
+        return dir->ops.unlinkat(dir->ctx, dir->dp, name);
+    }
+    if (dir->ops.unlink == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    char* path = dmfsi_join(dir->path, dir->path_length, name);
+    if (path == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    int result = dir->ops.unlink(dir->ctx, path);
+    Dmod_Free(path);
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_rename, (dmfsi_dir_t* olddir, const char* oldname, dmfsi_dir_t* newdir, const char* newname) )
+{
+    if (olddir == NULL || newdir == NULL || oldname == NULL || newname == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (olddir->ctx != newdir->ctx) {
+        return DMFSI_ERR_INVALID;       // Files can not be moved between file systems
+    }
+    if (olddir->ops.renameat != NULL) {
+        return olddir->ops.renameat(olddir->ctx, olddir->dp, oldname, newdir->dp, newname);
+    }
+    if (olddir->ops.rename == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    char* oldpath = dmfsi_join(olddir->path, olddir->path_length, oldname);
+    char* newpath = dmfsi_join(newdir->path, newdir->path_length, newname);
+    int result = DMFSI_ERR_NO_SPACE;
+    if (oldpath != NULL && newpath != NULL) {
+        result = olddir->ops.rename(olddir->ctx, oldpath, newpath);
+    }
+    if (oldpath != NULL) {
+        Dmod_Free(oldpath);
+    }
+    if (newpath != NULL) {
+        Dmod_Free(newpath);
+    }
+    return result;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _dir_mkdir, (dmfsi_dir_t* dir, const char* name, int mode) )
+{
+    if (dir == NULL || name == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (dir->ops.mkdirat != NULL) {
+        return dir->ops.mkdirat(dir->ctx, dir->dp, name, mode);
+    }
+    if (dir->ops.mkdir == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    char* path = dmfsi_join(dir->path, dir->path_length, name);
+    if (path == NULL) {
+        return DMFSI_ERR_NO_SPACE;
+    }
+    int result = dir->ops.mkdir(dir->ctx, path, mode);
+    Dmod_Free(path);
+    return result;
+}
+
+// Entry of a directory listed by the generic tree operations
+typedef struct {
+    char* path;
+    dmfsi_stat_t stat;
+} dmfsi_tree_entry_t;
+
+static void dmfsi_tree_free(dmfsi_tree_entry_t* entries, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        Dmod_Free(entries[i].path);
+    }
+    if (entries != NULL) {
+        Dmod_Free(entries);
+    }
+}
+
+// List a directory whole, so its entries can be removed while they are visited
+static int dmfsi_tree_list(const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* dir,
+                           dmfsi_tree_entry_t** entries, size_t* count)
+{
+    size_t dir_length = dmfsi_strlen(dir);
+    size_t capacity = 0;
+    void* dp;
+    dmfsi_dir_entry_t dir_entry;
+    *entries = NULL;
+    *count = 0;
+    
+    int result = ops->opendir(ctx, &dp, dir);
+    if (result != DMFSI_OK) {
+        return result;
+    }
+    while (result == DMFSI_OK && ops->readdir(ctx, dp, &dir_entry) == DMFSI_OK) {
+        char* path = dmfsi_join(dir, dir_length, dir_entry.name);
+        if (path == NULL) {
+            result = DMFSI_ERR_NO_SPACE;
+            break;
+        }
+        if (!dmfsi_path_contains(dir, dir_length, path)) {
+            Dmod_Free(path);
+            continue;
+        }
+        if (*count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 16;
+            dmfsi_tree_entry_t* grown = (dmfsi_tree_entry_t*)Dmod_Malloc(new_capacity * sizeof(dmfsi_tree_entry_t));
+            if (grown == NULL) {
+                Dmod_Free(path);
+                result = DMFSI_ERR_NO_SPACE;
+                break;
+            }
+            for (size_t i = 0; i < *count; i++) {
+                grown[i] = (*entries)[i];
+            }
+            if (*entries != NULL) {
+                Dmod_Free(*entries);
+            }
+            *entries = grown;
+            capacity = new_capacity;
+        }
+        dmfsi_tree_entry_t* entry = &(*entries)[(*count)++];
+        entry->path = path;
+        entry->stat.size = dir_entry.size;
+        entry->stat.attr = dir_entry.attr;
+        entry->stat.ctime = dir_entry.time;
+        entry->stat.mtime = dir_entry.time;
+        entry->stat.atime = dir_entry.time;
+    }
+    ops->closedir(ctx, dp);
+    
+    if (result != DMFSI_OK) {
+        dmfsi_tree_free(*entries, *count);
+        *entries = NULL;
+        *count = 0;
+    }
+    return result;
+}
+
+static int dmfsi_tree_walk_dir(const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* dir,
+                               dmfsi_walk_fn_t callback, void* arg)
+{
+    dmfsi_tree_entry_t* entries;
+    size_t count;
+    int result = dmfsi_tree_list(ops, ctx, dir, &entries, &count);
+    
+    for (size_t i = 0; result == DMFSI_OK && i < count; i++) {
+        result = callback(arg, entries[i].path, &entries[i].stat);
+        if (result == DMFSI_OK && (entries[i].stat.attr & DMFSI_ATTR_DIRECTORY)) {
+            result = dmfsi_tree_walk_dir(ops, ctx, entries[i].path, callback, arg);
+        }
+    }
+    dmfsi_tree_free(entries, count);
+    return result;
+}
+
+// Removes the contents of a directory, returns the number of removed entries
+static int dmfsi_tree_remove_dir(const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* dir)
+{
+    dmfsi_tree_entry_t* entries;
+    size_t count;
+    int result = dmfsi_tree_list(ops, ctx, dir, &entries, &count);
+    int removed = 0;
+    
+    for (size_t i = 0; result >= 0 && i < count; i++) {
+        if (entries[i].stat.attr & DMFSI_ATTR_DIRECTORY) {
+            result = dmfsi_tree_remove_dir(ops, ctx, entries[i].path);
+            removed += (result > 0) ? result : 0;
+        }
+        if (result >= 0) {
+            result = ops->unlink(ctx, entries[i].path);
+            removed += (result == DMFSI_OK) ? 1 : 0;
+        }
+    }
+    dmfsi_tree_free(entries, count);
+    return (result < 0) ? result : removed;
+}
+
+// Check if the generic layer can list a directory of the implementation
+static int dmfsi_tree_is_dir(const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path)
+{
+    return ops->opendir != NULL && ops->readdir != NULL && ops->closedir != NULL
+        && ops->direxists != NULL && ops->direxists(ctx, path) == 1;
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _tree_walk, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path, dmfsi_walk_fn_t callback, void* arg) )
+{
+    if (ops == NULL || path == NULL || callback == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ops->walk != NULL) {
+        return ops->walk(ctx, path, callback, arg);
+    }
+    
+    if (dmfsi_tree_is_dir(ops, ctx, path)) {
+        return dmfsi_tree_walk_dir(ops, ctx, path, callback, arg);
+    }
+    dmfsi_stat_t stat;
+    if (ops->stat == NULL || ops->stat(ctx, path, &stat) != DMFSI_OK) {
+        return DMFSI_ERR_NOT_FOUND;
+    }
+    return callback(arg, path, &stat);
+}
+
+dmod_dmfsi_api_declaration( 1.0, int, _tree_remove, (const dmfsi_ops_t* ops, dmfsi_context_t ctx, const char* path) )
+{
+    if (ops == NULL || path == NULL) {
+        return DMFSI_ERR_INVALID;
+    }
+    if (ops->remove_tree != NULL) {
+        return ops->remove_tree(ctx, path);
+    }
+    if (ops->unlink == NULL) {
+        return DMFSI_ERR_GENERAL;
+    }
+    
+    int removed = 0;
+    if (dmfsi_tree_is_dir(ops, ctx, path)) {
+        removed = dmfsi_tree_remove_dir(ops, ctx, path);
+        if (removed < 0) {
+            return removed;
+        }
+        // The root itself can not be removed
+        if (path[0] == '/' && path[1] == '\0') {
+            return removed;
+        }
+    }
+    int result = ops->unlink(ctx, path);
+    if (result != DMFSI_OK) {
+        return (removed > 0) ? removed : result;
+    }
+    return removed + 1;
+}
+
 // This module doesn't have init/deinit since it's just an interface definition
 int dmod_init(const Dmod_Config_t *Config)
 {